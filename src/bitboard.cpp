@@ -0,0 +1,230 @@
+#include "bitboard.hpp"
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace bitboards {
+
+std::array<bitboard_t, 64> knight_attacks;
+std::array<bitboard_t, 64> king_attacks;
+std::array<std::array<bitboard_t, 64>, 2> pawn_attacks;
+std::array<std::array<bitboard_t, 64>, 64> between;
+std::array<magic_t, 64> bishop_magics;
+std::array<magic_t, 64> rook_magics;
+bool use_pext = false;
+
+// Sum of 2^bits(mask) over all the squares
+static std::array<bitboard_t, 0x1480> bishop_table;
+static std::array<bitboard_t, 0x19000> rook_table;
+
+static constexpr std::array<std::array<int, 2>, 4> bishop_directions = {
+    {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}}};
+static constexpr std::array<std::array<int, 2>, 4> rook_directions = {
+    {{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("bmi2"))) uint64_t pext(const bitboard_t b,
+                                              const bitboard_t mask)
+{
+  return _pext_u64(b, mask);
+}
+#else
+uint64_t pext(const bitboard_t b, bitboard_t mask)
+{
+  // Portable fallback, never used in the hot path
+  uint64_t res = 0;
+  for (uint64_t bit = 1; mask; bit <<= 1) {
+    if (b & mask & -mask) { res |= bit; }
+    mask &= mask - 1;
+  }
+  return res;
+}
+#endif
+
+
+static bool cpu_has_bmi2()
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2");
+#else
+  return false;
+#endif
+}
+
+
+static inline bool on_board(const int file, const int rank)
+{
+  return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+}
+
+
+/**
+ * Attacks of a slider walking every direction until the first blocker
+ */
+static bitboard_t sliding_attacks(
+    const std::array<std::array<int, 2>, 4>& directions,
+    const uint8_t sq,
+    const bitboard_t occupied)
+{
+  bitboard_t res = 0;
+
+  for (const auto& d : directions) {
+    int file = (sq & 7) + d[0];
+    int rank = (sq >> 3) + d[1];
+
+    while (on_board(file, rank)) {
+      const bitboard_t b = square_bb(rank * 8 + file);
+      res |= b;
+      if (occupied & b) { break; }
+      file += d[0];
+      rank += d[1];
+    }
+  }
+
+  return res;
+}
+
+
+static bitboard_t step_attacks(const uint8_t sq,
+                               const int* offsets,
+                               const int count)
+{
+  bitboard_t res = 0;
+
+  for (int i = 0; i < count; ++i) {
+    const int file = (sq & 7) + offsets[i * 2];
+    const int rank = (sq >> 3) + offsets[i * 2 + 1];
+    if (on_board(file, rank)) { res |= square_bb(rank * 8 + file); }
+  }
+
+  return res;
+}
+
+
+/**
+ * Sparse random numbers make good magic candidates
+ */
+static uint64_t sparse_random(uint64_t& state)
+{
+  auto next = [&state]() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+  };
+
+  return next() & next() & next();
+}
+
+
+static void init_magics(const std::array<std::array<int, 2>, 4>& directions,
+                        std::array<magic_t, 64>& magics,
+                        bitboard_t* table)
+{
+  static std::array<bitboard_t, 4096> occupancy;
+  static std::array<bitboard_t, 4096> reference;
+  static std::array<int, 4096> epoch;
+  int current_epoch = 0;
+  uint64_t seed = 0x2545F4914F6CDD1DULL;
+  bitboard_t* attacks = table;
+
+  for (uint8_t sq = 0; sq < 64; ++sq) {
+    // The board edges are never relevant blockers
+    const bitboard_t edges =
+        ((RANK_1_BB | RANK_8_BB) & ~(RANK_1_BB << (8 * (sq >> 3)))) |
+        ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << (sq & 7)));
+
+    magic_t& m = magics[sq];
+    m.mask = sliding_attacks(directions, sq, 0) & ~edges;
+    m.shift = 64 - popcount(m.mask);
+    m.attacks = attacks;
+
+    // Carry-Rippler: enumerate all the subsets of the mask
+    int size = 0;
+    bitboard_t b = 0;
+    do {
+      occupancy[size] = b;
+      reference[size] = sliding_attacks(directions, sq, b);
+      if (use_pext) { m.attacks[pext(b, m.mask)] = reference[size]; }
+      ++size;
+      b = (b - m.mask) & m.mask;
+    } while (b);
+
+    attacks += size;
+
+    if (use_pext) { continue; }
+
+    // Try random magics until one maps every subset without bad collisions
+    for (int i = 0; i < size;) {
+      do {
+        m.magic = sparse_random(seed);
+      } while (popcount((m.magic * m.mask) >> 56) < 6);
+
+      ++current_epoch;
+      for (i = 0; i < size; ++i) {
+        const unsigned index = magic_index(m, occupancy[i]);
+
+        if (epoch[index] < current_epoch) {
+          epoch[index] = current_epoch;
+          m.attacks[index] = reference[i];
+        } else if (m.attacks[index] != reference[i]) {
+          break;
+        }
+      }
+    }
+  }
+}
+
+
+void init()
+{
+  static bool done = false;
+  if (done) { return; }
+  done = true;
+
+  use_pext = cpu_has_bmi2();
+
+  static constexpr int knight_offsets[] = {1,  2,  2,  1,  2,  -1, 1,  -2,
+                                           -1, -2, -2, -1, -2, 1,  -1, 2};
+  static constexpr int king_offsets[] = {1,  0, 1,  1,  0,  1, -1, 1,
+                                         -1, 0, -1, -1, 0, -1, 1,  -1};
+  static constexpr int white_pawn_offsets[] = {-1, 1, 1, 1};
+  static constexpr int black_pawn_offsets[] = {-1, -1, 1, -1};
+
+  for (uint8_t sq = 0; sq < 64; ++sq) {
+    knight_attacks[sq] = step_attacks(sq, knight_offsets, 8);
+    king_attacks[sq] = step_attacks(sq, king_offsets, 8);
+    pawn_attacks[static_cast<int>(color_t::WHITE)][sq] =
+        step_attacks(sq, white_pawn_offsets, 2);
+    pawn_attacks[static_cast<int>(color_t::BLACK)][sq] =
+        step_attacks(sq, black_pawn_offsets, 2);
+  }
+
+  init_magics(bishop_directions, bishop_magics, bishop_table.data());
+  init_magics(rook_directions, rook_magics, rook_table.data());
+
+  // Squares strictly between two aligned squares
+  for (uint8_t a = 0; a < 64; ++a) {
+    for (uint8_t b = 0; b < 64; ++b) {
+      between[a][b] = 0;
+
+      if (bishop_attacks(a, 0) & square_bb(b)) {
+        between[a][b] =
+            bishop_attacks(a, square_bb(b)) & bishop_attacks(b, square_bb(a));
+      } else if (rook_attacks(a, 0) & square_bb(b)) {
+        between[a][b] =
+            rook_attacks(a, square_bb(b)) & rook_attacks(b, square_bb(a));
+      }
+    }
+  }
+}
+
+
+// The tables are ready before main
+[[maybe_unused]] static const bool initialized = (init(), true);
+
+}  // namespace bitboards
@@ -0,0 +1,142 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "piece.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+// clang-format off
+/**
+ * Bitboards
+ *
+ * One bit per square, bit 0 is A1 and bit 63 is H8. Squares in this layout
+ * (0 - 63) are called sq64 to tell them apart from the 0x88 indexes of the
+ * mailbox.
+ *
+ *     A  B  C  D  E  F  G  H
+ * 8 | 56 57 58 59 60 61 62 63
+ * ...
+ * 1 |  0  1  2  3  4  5  6  7
+ */
+// clang-format on
+using bitboard_t = uint64_t;
+
+static constexpr bitboard_t FILE_A_BB = 0x0101010101010101ULL;
+static constexpr bitboard_t FILE_H_BB = FILE_A_BB << 7;
+static constexpr bitboard_t RANK_1_BB = 0xFFULL;
+static constexpr bitboard_t RANK_3_BB = RANK_1_BB << 16;
+static constexpr bitboard_t RANK_6_BB = RANK_1_BB << 40;
+static constexpr bitboard_t RANK_8_BB = RANK_1_BB << 56;
+
+
+inline constexpr uint8_t to_sq64(const uint8_t index)
+{
+  return (index + (index & 7)) >> 1;
+}
+
+inline constexpr uint8_t to_index88(const uint8_t sq)
+{
+  return sq + (sq & ~7);
+}
+
+inline constexpr bitboard_t square_bb(const uint8_t sq)
+{
+  return 1ULL << sq;
+}
+
+
+inline int popcount(const bitboard_t b)
+{
+#if defined(_MSC_VER)
+  return static_cast<int>(__popcnt64(b));
+#else
+  return __builtin_popcountll(b);
+#endif
+}
+
+
+inline uint8_t lsb(const bitboard_t b)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, b);
+  return static_cast<uint8_t>(index);
+#else
+  return static_cast<uint8_t>(__builtin_ctzll(b));
+#endif
+}
+
+
+inline uint8_t pop_lsb(bitboard_t& b)
+{
+  const uint8_t sq = lsb(b);
+  b &= b - 1;
+  return sq;
+}
+
+
+namespace bitboards {
+
+/**
+ * Slider attacks. Every square has a mask of the relevant blockers and a slice
+ * of the shared attack table, indexed either with a magic multiplication or
+ * with PEXT when the CPU has fast BMI2 (chosen once at startup).
+ */
+struct magic_t
+{
+  bitboard_t mask;
+  bitboard_t magic;
+  bitboard_t* attacks;
+  unsigned shift;
+};
+
+extern std::array<bitboard_t, 64> knight_attacks;
+extern std::array<bitboard_t, 64> king_attacks;
+extern std::array<std::array<bitboard_t, 64>, 2> pawn_attacks;
+extern std::array<std::array<bitboard_t, 64>, 64> between;
+extern std::array<magic_t, 64> bishop_magics;
+extern std::array<magic_t, 64> rook_magics;
+extern bool use_pext;
+
+/**
+ * Fill the tables. Runs once before main, calling it again does nothing.
+ */
+void init();
+
+uint64_t pext(const bitboard_t b, const bitboard_t mask);
+
+
+inline unsigned magic_index(const magic_t& m, const bitboard_t occupied)
+{
+  if (use_pext) { return static_cast<unsigned>(pext(occupied, m.mask)); }
+
+  return static_cast<unsigned>(((occupied & m.mask) * m.magic) >> m.shift);
+}
+
+
+inline bitboard_t bishop_attacks(const uint8_t sq, const bitboard_t occupied)
+{
+  const magic_t& m = bishop_magics[sq];
+  return m.attacks[magic_index(m, occupied)];
+}
+
+
+inline bitboard_t rook_attacks(const uint8_t sq, const bitboard_t occupied)
+{
+  const magic_t& m = rook_magics[sq];
+  return m.attacks[magic_index(m, occupied)];
+}
+
+
+/**
+ * Squares attacked by a pawn of the given color standing on sq
+ */
+inline bitboard_t pawn_attacks_from(const color_t c, const uint8_t sq)
+{
+  return pawn_attacks[static_cast<int>(c)][sq];
+}
+
+}  // namespace bitboards
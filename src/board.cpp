@@ -1,10 +1,31 @@
 #include "board.hpp"
-#include <iterator>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
 #include <string>
-#include <vector>
 #include "exceptions.hpp"
-#include "utils.hpp"
+
+
+/**
+ * Castling rights that survive a move touching the square. Moving the king or
+ * a rook, or capturing a rook, clears the matching rights.
+ */
+static constexpr std::array<uint8_t, BOARD_ARRAY_SIZE> castling_mask = [] {
+  std::array<uint8_t, BOARD_ARRAY_SIZE> mask = {};
+  for (auto& I : mask) {
+    I = WQ | WK | BQ | BK;
+  }
+
+  mask[0x00] = WK | BQ | BK;  // a1
+  mask[0x07] = WQ | BQ | BK;  // h1
+  mask[0x04] = BQ | BK;       // e1
+  mask[0x70] = WQ | WK | BK;  // a8
+  mask[0x77] = WQ | WK | BQ;  // h8
+  mask[0x74] = WQ | WK;       // e8
+
+  return mask;
+}();
 
 
 board_t::board_t()
@@ -15,21 +36,137 @@ board_t::board_t()
 
 void board_t::cleanup()
 {
-  for (auto& I : _board) {
-    I = nullptr;
+  _board.fill(EMPTY);
+  _piece_count.fill(0);
+  _type_bb.fill(0);
+  _color_bb.fill(0);
+  _psqt = {};
+  _phase = 0;
+  _pawn_key = 0;
+}
+
+
+uint64_t board_t::compute_key() const
+{
+  uint64_t key = 0;
+
+  for (int side = 0; side < 2; ++side) {
+    for (uint8_t slot = 0; slot < _piece_count[side]; ++slot) {
+      const uint8_t index = _piece_list[side][slot];
+      key ^= zobrist::KEYS.piece_square[piece_at(index)][index];
+    }
+  }
+
+  key ^= zobrist::KEYS.castling[_available_castling];
+
+  if (_en_passant_square != NO_SQUARE) {
+    key ^= zobrist::KEYS.en_passant[_en_passant_square & 7];
+  }
+
+  if (_active_color == color_t::BLACK) { key ^= zobrist::KEYS.side; }
+
+  return key;
+}
+
+
+fen_error_t board_t::add_piece(const uint8_t index, const uint8_t p)
+{
+  const int side = static_cast<int>(piece_color(p));
+
+  if (_piece_count[side] >= MAX_PIECES_PER_SIDE) {
+    return fen_error_t::TOO_MANY_PIECES;
+  }
+
+  uint8_t slot = _piece_count[side]++;
+
+  // Keep the king in the slot 0
+  if (piece_type(p) == KING && slot != 0) {
+    if (piece_type(_board[_piece_list[side][0]]) == KING) {
+      return fen_error_t::TOO_MANY_KINGS;
+    }
+
+    const uint8_t moved = _piece_list[side][0];
+    _piece_list[side][slot] = moved;
+    _board[moved] = (slot << 4) | (_board[moved] & PIECE_MASK);
+    slot = 0;
+  }
+
+  _piece_list[side][slot] = index;
+  _board[index] = (slot << 4) | p;
+  toggle_bb(index, p);
+  add_terms(index, p);
+
+  return fen_error_t::OK;
+}
+
+
+static inline bool is_blank(const char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+/**
+ * Unsigned decimal number that ends at a blank or at the end of the string
+ */
+static inline bool parse_uint(const std::string_view s, size_t& i, int& value)
+{
+  const char* begin = s.data() + i;
+  const char* end = s.data() + s.size();
+
+  if (begin == end || !std::isdigit(static_cast<unsigned char>(*begin))) {
+    return false;
+  }
+
+  const auto res = std::from_chars(begin, end, value);
+  if (res.ec != std::errc() || (res.ptr != end && !is_blank(*res.ptr))) {
+    return false;
   }
+
+  i = res.ptr - s.data();
+  return true;
+}
+
+
+void board_t::load(const std::string_view FEN)
+{
+  const fen_result_t res = parse(FEN);
+
+  if (!res) { throw FAN_exception(fen_error_message(res, FEN)); }
+}
+
+
+fen_result_t board_t::parse(const std::string_view FEN,
+                            const bool clocks_optional) noexcept
+{
+  const fen_result_t res = parse_fields(FEN, clocks_optional);
+
+  // Never leave a half parsed position behind
+  if (!res) { parse_fields(FEN_INIT_POS, false); }
+
+  return res;
 }
 
 
-void board_t::load(const std::string& FEN)
+fen_result_t board_t::parse_fields(const std::string_view FEN,
+                                   const bool clocks_optional) noexcept
 {
   // Clean the board first
   cleanup();
+  _history.clear();
 
-  // Start parsing
-  auto sections = split_string(FEN);
+  const size_t size = FEN.size();
+  size_t i = 0;
 
-  if (sections.size() != 6) { throw FAN_exception("Bad FEN string: " + FEN); }
+  auto fail = [&i](const fen_error_t e) { return fen_result_t{e, i}; };
+
+  // Skip the blanks before a field, false if the string is over
+  auto next_field = [&]() {
+    while (i < size && is_blank(FEN[i])) {
+      ++i;
+    }
+    return i < size;
+  };
 
   /*****************************************************************************
    * 0. Piece placement data
@@ -44,74 +181,53 @@ void board_t::load(const std::string& FEN)
    * White ("PNBRQK")
    * Black ("pnbrqk")
    ****************************************************************************/
+  if (!next_field()) { return fail(fen_error_t::MISSING_FIELD); }
 
   int file = 0;
   int rank = 7;
 
-  for (const char c : sections[0]) {
-    switch (c) {
-      case '/':
-        file = 0;
-        --rank;
-        break;
-
-      case '1':
-        file += 1;
-        break;
-      case '2':
-        file += 2;
-        break;
-      case '3':
-        file += 3;
-        break;
-      case '4':
-        file += 4;
-        break;
-      case '5':
-        file += 5;
-        break;
-      case '6':
-        file += 6;
-        break;
-      case '7':
-        file += 7;
-        break;
-      case '8':
-        file += 8;
-        break;
-
-      case 'P':
-      case 'N':
-      case 'B':
-      case 'R':
-      case 'Q':
-      case 'K':
-      case 'p':
-      case 'n':
-      case 'b':
-      case 'r':
-      case 'q':
-      case 'k':
-        set(file, rank, c);
-        ++file;
-        break;
-
-      default:
-        // We get a non valid string
-        throw FAN_exception("Invalid char in FEN string [" + STR(c) +
-                            "]. FEN: " + FEN);
+  for (; i < size && !is_blank(FEN[i]); ++i) {
+    const char c = FEN[i];
+
+    if (c == '/') {
+      if (file != 8 || rank == 0) { return fail(fen_error_t::BAD_RANK); }
+      file = 0;
+      --rank;
+    } else if (c >= '1' && c <= '8') {
+      file += c - '0';
+      if (file > 8) { return fail(fen_error_t::BAD_RANK); }
+    } else {
+      const uint8_t p = char_to_piece(c);
+      if (p == EMPTY) { return fail(fen_error_t::INVALID_PIECE); }
+      if (file > 7) { return fail(fen_error_t::BAD_RANK); }
+
+      if (piece_type(p) == PAWN && (rank == 0 || rank == 7)) {
+        return fail(fen_error_t::PAWN_ON_LAST_RANK);
+      }
+
+      const fen_error_t e = add_piece(to_index(file, rank), p);
+      if (e != fen_error_t::OK) { return fail(e); }
+      ++file;
+    }
+  }
+
+  if (file != 8 || rank != 0) { return fail(fen_error_t::BAD_RANK); }
+
+  // Both sides need exactly one king, it lives in the slot 0 of the list
+  for (int side = 0; side < 2; ++side) {
+    if (_piece_count[side] == 0 ||
+        piece_type(_board[_piece_list[side][0]]) != KING) {
+      return fail(fen_error_t::MISSING_KING);
     }
   }
 
   /***************************************************************************
    * 1. Active color
    **************************************************************************/
-  if (sections[1].size() != 1) {
-    throw FAN_exception("invalid active color section. FEN: " + FEN);
-  }
+  if (!next_field()) { return fail(fen_error_t::MISSING_FIELD); }
 
-  char color = sections[1][0];
-  switch (color) {
+  const size_t color_position = i;
+  switch (FEN[i]) {
     case 'w':
       _active_color = color_t::WHITE;
       break;
@@ -119,8 +235,11 @@ void board_t::load(const std::string& FEN)
       _active_color = color_t::BLACK;
       break;
     default:
-      throw FAN_exception("Invalid color char in FEN string [" +
-                          std::string(1, color) + "]. FEN: " + FEN);
+      return fail(fen_error_t::INVALID_COLOR);
+  }
+
+  if (++i < size && !is_blank(FEN[i])) {
+    return fail(fen_error_t::INVALID_COLOR);
   }
 
   /***************************************************************************
@@ -132,114 +251,441 @@ void board_t::load(const std::string& FEN)
    * "k" if Black can castle kingside
    * "q" if Black can castle queenside
    **************************************************************************/
-  if (sections[2].size() < 1 || sections[2].size() > 4) {
-    throw FAN_exception("Invalid castling availability section size. FEN: " +
-                        FEN);
-  }
+  if (!next_field()) { return fail(fen_error_t::MISSING_FIELD); }
 
   _available_castling = 0x00;
-  for (const char c : sections[2]) {
-    switch (c) {
-      case '-':
-        _available_castling = 0x00;
-        if (sections[2].size() != 1) {
-          throw FAN_exception(
-              "Invalid castling availability section size. No castling "
-              "available char is set but the section size is too big. FEN: " +
-              FEN);
-        }
-        break;
-      case 'K':
-        _available_castling |= WK;
-        break;
-      case 'Q':
-        _available_castling |= WQ;
-        break;
-      case 'k':
-        _available_castling |= BK;
-        break;
-      case 'q':
-        _available_castling |= BQ;
-        break;
-
-      default:
-        throw FAN_exception("Invalid castling availability character [" +
-                            std::string(1, c) + "]. FEN: " + FEN);
+  if (FEN[i] == '-') {
+    ++i;
+  } else {
+    for (; i < size && !is_blank(FEN[i]); ++i) {
+      uint8_t right = 0;
+      switch (FEN[i]) {
+        case 'K':
+          right = WK;
+          break;
+        case 'Q':
+          right = WQ;
+          break;
+        case 'k':
+          right = BK;
+          break;
+        case 'q':
+          right = BQ;
+          break;
+        default:
+          return fail(fen_error_t::INVALID_CASTLING);
+      }
+
+      if (_available_castling & right) {
+        return fail(fen_error_t::INVALID_CASTLING);
+      }
+      _available_castling |= right;
     }
   }
 
+  if (i < size && !is_blank(FEN[i])) {
+    return fail(fen_error_t::INVALID_CASTLING);
+  }
+
   /***************************************************************************
    * 3. En passant target square
    *
    * "-" None
    **************************************************************************/
-  if (sections[3].size() < 1 || sections[3].size() > 2) {
-    throw FAN_exception("Invalid en passant section size. FEN: " + FEN);
-  }
-
-  if (sections[3].size() == 1 && sections[3][0] != '-') {
-    throw FAN_exception("Invalid en passant section char [ " +
-                        std::string(1, sections[3][0]) + "]. FEN: " + FEN);
-  }
+  if (!next_field()) { return fail(fen_error_t::MISSING_FIELD); }
 
-  if (sections[3].size() == 2) {
-    if (!isalpha(sections[3][0]) || !isdigit(sections[3][1])) {
-      throw FAN_exception(
-          "Invalid en passant section. Wrong algebraic notation [" +
-          sections[3] + "]. FEN: " + FEN);
+  _en_passant_square = NO_SQUARE;
+  if (FEN[i] == '-') {
+    ++i;
+  } else {
+    if (i + 1 >= size || FEN[i] < 'a' || FEN[i] > 'h' || FEN[i + 1] < '1' ||
+        FEN[i + 1] > '8') {
+      return fail(fen_error_t::INVALID_EN_PASSANT);
     }
+
+    _en_passant_square = to_index(FEN[i] - 'a', FEN[i + 1] - '1');
+    if (!en_passant_valid()) { return fail(fen_error_t::INVALID_EN_PASSANT); }
+    i += 2;
   }
 
-  _en_passant_target_square = sections[3];
+  if (i < size && !is_blank(FEN[i])) {
+    return fail(fen_error_t::INVALID_EN_PASSANT);
+  }
 
   /***************************************************************************
    * 4. Halfmove clock
    *
    * The number of halfmoves since the last capture or pawn advance, used for
    * the fifty-move rule.
+   *
+   * 5. Fullmove number
+   *
+   * The number of the full moves. It starts at 1 and is incremented after
+   * Black's move.
+   *
+   * Both optional in EPD.
    **************************************************************************/
-  const std::string& half_move = sections[4];
-  if (half_move.size() < 1) {
-    throw FAN_exception("Invalid Halfmove clock section size. FEN: " + FEN);
+  _halfmove_clock = 0;
+  _full_move = 1;
+
+  const size_t clocks = i;
+  const bool has_clocks = next_field() &&
+                          std::isdigit(static_cast<unsigned char>(FEN[i]));
+
+  if (has_clocks || !clocks_optional) {
+    if (!next_field()) { return fail(fen_error_t::MISSING_FIELD); }
+    if (!parse_uint(FEN, i, _halfmove_clock)) {
+      return fail(fen_error_t::INVALID_HALFMOVE_CLOCK);
+    }
+
+    if (!next_field()) { return fail(fen_error_t::MISSING_FIELD); }
+    if (!parse_uint(FEN, i, _full_move) || _full_move < 1) {
+      return fail(fen_error_t::INVALID_FULLMOVE_NUMBER);
+    }
+  } else {
+    i = clocks;
   }
 
-  if (!is_uint(half_move)) {
-    throw FAN_exception(
-        "Invalid Halfmove clock section is not a number. FEN: " + FEN);
+  // In FEN nothing can follow, in EPD the operations do
+  if (!clocks_optional && next_field()) {
+    return fail(fen_error_t::TRAILING_CHARACTERS);
   }
 
-  try {
-    _halfmove_clock = static_cast<int>(std::stoul(half_move));
-  } catch (std::exception& e) {
-    throw FAN_exception("Can't convert Halfmove clock to integer.What: " +
-                        std::string(e.what()) + " FEN: " + FEN);
+  // The king could be captured, the move generation assumes it never is
+  if (opponent_in_check()) {
+    return fen_result_t{fen_error_t::OPPONENT_IN_CHECK, color_position};
   }
 
-  /***************************************************************************
-   * 5. Fullmove number
-   *
-   * The number of the full moves. It starts at 1 and is incremented after
-   * Black's move.
-   **************************************************************************/
-  const std::string& full_move = sections[5];
-  if (full_move.size() < 1) {
-    throw FAN_exception("Invalid Fullmove number section size. FEN: " + FEN);
+  _key = compute_key();
+
+  return fen_result_t{fen_error_t::OK, i};
+}
+
+
+bool board_t::en_passant_valid() const
+{
+  if (_en_passant_square == NO_SQUARE) { return true; }
+
+  // White to move: black just pushed to the fifth rank through the sixth
+  const bool white = _active_color == color_t::WHITE;
+  const uint8_t rank = _en_passant_square >> 4;
+  if (rank != (white ? 5 : 2)) { return false; }
+
+  const uint8_t pawn = white ? _en_passant_square - 16 : _en_passant_square + 16;
+  return piece_at(_en_passant_square) == EMPTY &&
+         piece_at(pawn) == make_piece(opposite(_active_color), PAWN);
+}
+
+
+std::string board_t::fen() const
+{
+  std::string res;
+  res.reserve(90);
+
+  for (int rank = 7; rank >= 0; --rank) {
+    int empty = 0;
+
+    for (int file = 0; file < 8; ++file) {
+      const uint8_t p = piece_at(to_index(file, rank));
+      if (p == EMPTY) {
+        ++empty;
+        continue;
+      }
+
+      if (empty) { res += static_cast<char>('0' + empty); }
+      empty = 0;
+      res += piece_to_char(p);
+    }
+
+    if (empty) { res += static_cast<char>('0' + empty); }
+    if (rank) { res += '/'; }
+  }
+
+  res += _active_color == color_t::WHITE ? " w " : " b ";
+
+  if (_available_castling & WK) { res += 'K'; }
+  if (_available_castling & WQ) { res += 'Q'; }
+  if (_available_castling & BK) { res += 'k'; }
+  if (_available_castling & BQ) { res += 'q'; }
+  if (_available_castling == 0x00) { res += '-'; }
+
+  res += ' ';
+  res += en_passant_target_square();
+  res += ' ';
+  res += std::to_string(_halfmove_clock);
+  res += ' ';
+  res += std::to_string(_full_move);
+
+  return res;
+}
+
+
+std::string fen_error_message(const fen_result_t& res, const std::string_view FEN)
+{
+  std::string msg;
+
+  switch (res.error) {
+    case fen_error_t::OK:
+      return "No error";
+    case fen_error_t::MISSING_FIELD:
+      msg = "Bad FEN string, missing field";
+      break;
+    case fen_error_t::TRAILING_CHARACTERS:
+      msg = "Bad FEN string, unexpected characters after the last field";
+      break;
+    case fen_error_t::INVALID_PIECE:
+      msg = "Invalid char in FEN string";
+      break;
+    case fen_error_t::BAD_RANK:
+      msg = "Invalid piece placement, every rank needs 8 squares and the "
+            "board 8 ranks";
+      break;
+    case fen_error_t::PAWN_ON_LAST_RANK:
+      msg = "Pawn on the first or last rank";
+      break;
+    case fen_error_t::TOO_MANY_PIECES:
+      msg = "Too many pieces for one side";
+      break;
+    case fen_error_t::TOO_MANY_KINGS:
+      msg = "More than one king for one side";
+      break;
+    case fen_error_t::MISSING_KING:
+      msg = "Missing king";
+      break;
+    case fen_error_t::INVALID_COLOR:
+      msg = "Invalid color char in FEN string";
+      break;
+    case fen_error_t::INVALID_CASTLING:
+      msg = "Invalid castling availability section";
+      break;
+    case fen_error_t::INVALID_EN_PASSANT:
+      msg = "Invalid en passant section. Wrong algebraic notation or no "
+            "pawn that just made a double push";
+      break;
+    case fen_error_t::INVALID_HALFMOVE_CLOCK:
+      msg = "Invalid Halfmove clock section, it is not a number";
+      break;
+    case fen_error_t::INVALID_FULLMOVE_NUMBER:
+      msg = "Invalid Fullmove number section, it must be a number greater "
+            "than 0";
+      break;
+    case fen_error_t::OPPONENT_IN_CHECK:
+      msg = "The side not to move is in check";
+      break;
+  }
+
+  if (res.position < FEN.size()) {
+    msg += " [" + std::string(1, FEN[res.position]) + "] at position " +
+           std::to_string(res.position);
+  }
+
+  return msg + ". FEN: " + std::string(FEN);
+}
+
+
+bool board_t::move(const uint8_t from_file,
+                   const uint8_t from_rank,
+                   const uint8_t to_file,
+                   const uint8_t to_rank)
+{
+  const uint8_t to = to_index(to_file, to_rank);
+
+  move_list_t moves;
+  get_valid_moves(from_file, from_rank, moves);
+
+  for (const move_t& m : moves) {
+    if (m.to == to && (!m.is_promotion() || m.promotion == QUEEN)) {
+      make_move(m);
+      trim_history();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+void board_t::trim_history()
+{
+  _history.keep_last(std::clamp(_halfmove_clock, 0, 100));
+}
+
+
+void board_t::make_move(const move_t& m)
+{
+  const color_t us = _active_color;
+  const uint8_t moving = piece_at(m.from);
+
+  assert(moving != EMPTY);
+  assert(piece_color(moving) == us);
+  undo_t& u = _history.push();
+  u.move = m;
+  u.captured = EMPTY;
+  u.captured_slot = 0;
+  u.available_castling = _available_castling;
+  u.en_passant_square = _en_passant_square;
+  u.halfmove_clock = _halfmove_clock;
+  u.key = _key;
+
+  const auto& keys = zobrist::KEYS;
+  uint64_t key = _key ^ keys.side;
+
+  if (m.flags & MOVE_EN_PASSANT) {
+    const uint8_t captured_index =
+        us == color_t::WHITE ? m.to - 0x10 : m.to + 0x10;
+    u.captured = piece_at(captured_index);
+    u.captured_slot = remove_piece(captured_index);
+    key ^= keys.piece_square[u.captured][captured_index];
+  } else if (m.flags & MOVE_CAPTURE) {
+    u.captured = piece_at(m.to);
+    u.captured_slot = remove_piece(m.to);
+    key ^= keys.piece_square[u.captured][m.to];
+  }
+
+  move_piece(m.from, m.to);
+  key ^= keys.piece_square[moving][m.from];
+
+  if (m.is_promotion()) {
+    const uint8_t promoted = make_piece(us, m.promotion);
+    change_piece(m.to, promoted);
+    key ^= keys.piece_square[promoted][m.to];
+  } else {
+    key ^= keys.piece_square[moving][m.to];
+  }
+
+  // Castling also moves the rook
+  if (m.flags & MOVE_CASTLING) {
+    const uint8_t base = m.from & 0x70;
+    const uint8_t rook = make_piece(us, ROOK);
+    const uint8_t rook_from = (m.to & 7) == 6 ? base + 7 : base + 0;
+    const uint8_t rook_to = (m.to & 7) == 6 ? base + 5 : base + 3;
+
+    move_piece(rook_from, rook_to);
+    key ^= keys.piece_square[rook][rook_from] ^ keys.piece_square[rook][rook_to];
+  }
+
+  key ^= keys.castling[_available_castling];
+  _available_castling &= castling_mask[m.from] & castling_mask[m.to];
+  key ^= keys.castling[_available_castling];
+
+  if (_en_passant_square != NO_SQUARE) {
+    key ^= keys.en_passant[_en_passant_square & 7];
+  }
+
+  _en_passant_square = NO_SQUARE;
+  if (m.flags & MOVE_DOUBLE_PUSH) {
+    _en_passant_square = (m.from + m.to) / 2;
+    key ^= keys.en_passant[_en_passant_square & 7];
+  }
+
+  _key = key;
+
+  if (piece_type(moving) == PAWN || m.is_capture()) {
+    _halfmove_clock = 0;
+  } else {
+    ++_halfmove_clock;
+  }
+
+  if (us == color_t::BLACK) { ++_full_move; }
+  _active_color = opposite(us);
+}
+
+
+void board_t::unmake_move()
+{
+  const undo_t& u = _history.pop();
+  const move_t& m = u.move;
+  const color_t us = opposite(_active_color);
+
+  _active_color = us;
+  if (us == color_t::BLACK) { --_full_move; }
+
+  _available_castling = u.available_castling;
+  _en_passant_square = u.en_passant_square;
+  _halfmove_clock = u.halfmove_clock;
+  _key = u.key;
+
+  if (m.flags & MOVE_CASTLING) {
+    const uint8_t base = m.from & 0x70;
+    if ((m.to & 7) == 6) {
+      move_piece(base + 5, base + 7);
+    } else {
+      move_piece(base + 3, base + 0);
+    }
   }
 
-  if (!is_uint(full_move)) {
-    throw FAN_exception(
-        "Invalid Fullmove number section is not a number. FEN: " + FEN);
+  if (m.is_promotion()) {
+    change_piece(m.to, make_piece(us, PAWN));
   }
 
-  try {
-    _full_move = static_cast<int>(std::stoul(full_move));
-  } catch (std::exception& e) {
-    throw FAN_exception("Can't convert Fullmove number to integer. What: " +
-                        std::string(e.what()) + " FEN: " + FEN);
+  move_piece(m.to, m.from);
+
+  if (m.flags & MOVE_EN_PASSANT) {
+    restore_piece(us == color_t::WHITE ? m.to - 0x10 : m.to + 0x10, u.captured,
+                  u.captured_slot);
+  } else if (m.flags & MOVE_CAPTURE) {
+    restore_piece(m.to, u.captured, u.captured_slot);
   }
+}
+
 
-  if (_full_move < 1) {
-    throw FAN_exception("Fullmove number can't be less then 1 but it is " +
-                        std::string(STR(_full_move)) + " FEN: " + FEN);
+void board_t::make_null_move()
+{
+  undo_t& u = _history.push();
+  u.move = NULL_MOVE;
+  u.captured = EMPTY;
+  u.captured_slot = 0;
+  u.available_castling = _available_castling;
+  u.en_passant_square = _en_passant_square;
+  u.halfmove_clock = _halfmove_clock;
+  u.key = _key;
+
+  _key ^= zobrist::KEYS.side;
+  if (_en_passant_square != NO_SQUARE) {
+    _key ^= zobrist::KEYS.en_passant[_en_passant_square & 7];
+    _en_passant_square = NO_SQUARE;
   }
+
+  // Nothing before a null move can be repeated
+  _halfmove_clock = 0;
+  _active_color = opposite(_active_color);
+}
+
+
+void board_t::unmake_null_move()
+{
+  const undo_t& u = _history.pop();
+  assert(u.move == NULL_MOVE);
+
+  _en_passant_square = u.en_passant_square;
+  _halfmove_clock = u.halfmove_clock;
+  _key = u.key;
+  _active_color = opposite(_active_color);
+}
+
+
+bool board_t::is_draw() const
+{
+  if (_halfmove_clock >= 100) { return true; }
+
+  // Only the same side to move can repeat, at least 4 plies back
+  const size_t reversible =
+      std::min<size_t>(_halfmove_clock, _history.size());
+  for (size_t i = 4; i <= reversible; i += 2) {
+    if (_history.back(i).key == _key) { return true; }
+  }
+
+  // KvK and a single minor piece
+  const int pieces = _piece_count[0] + _piece_count[1];
+  if (pieces == 2) { return true; }
+  if (pieces == 3) {
+    for (int side = 0; side < 2; ++side) {
+      if (_piece_count[side] == 2) {
+        const uint8_t type = piece_type(piece_at(_piece_list[side][1]));
+        return type == KNIGHT || type == BISHOP;
+      }
+    }
+  }
+
+  return false;
 }
@@ -1,13 +1,18 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <cassert>
-#include <memory>
-#include <pixello.hpp>
+#include <cstdint>
 #include <string>
-#include <vector>
+#include <string_view>
+#include <type_traits>
+#include "bitboard.hpp"
 #include "log.hpp"
+#include "move.hpp"
 #include "piece.hpp"
+#include "psqt.hpp"
 #include "utils.hpp"
+#include "zobrist.hpp"
 
 // clang-format off
 /**
@@ -35,36 +40,392 @@
 static constexpr char FEN_INIT_POS[] =
     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 static constexpr size_t BOARD_ARRAY_SIZE = 128;
+static constexpr size_t MAX_PIECES_PER_SIDE = 16;
+static constexpr size_t MAX_GAME_PLY = 1024;
+static constexpr uint8_t NO_SQUARE = 0x88;
 static constexpr uint8_t WQ = 0b0000001;
 static constexpr uint8_t WK = 0b0000010;
 static constexpr uint8_t BQ = 0b0000100;
 static constexpr uint8_t BK = 0b0001000;
 
 
-enum class color_t
+enum class fen_error_t : uint8_t
 {
-  BLACK,
-  WHITE
+  OK,
+  MISSING_FIELD,
+  TRAILING_CHARACTERS,
+  INVALID_PIECE,
+  BAD_RANK,
+  PAWN_ON_LAST_RANK,
+  TOO_MANY_PIECES,
+  TOO_MANY_KINGS,
+  MISSING_KING,
+  INVALID_COLOR,
+  INVALID_CASTLING,
+  INVALID_EN_PASSANT,
+  INVALID_HALFMOVE_CLOCK,
+  INVALID_FULLMOVE_NUMBER,
+  OPPONENT_IN_CHECK
 };
 
 
+/**
+ * Outcome of board_t::parse, in the spirit of std::from_chars. position is the
+ * offending character on error and the end of the parsed text on success.
+ */
+struct fen_result_t
+{
+  fen_error_t error = fen_error_t::OK;
+  size_t position = 0;
+
+  inline explicit operator bool() const { return error == fen_error_t::OK; }
+};
+
+
+/**
+ * Human readable description of a parse error. Only for the error path, it
+ * allocates.
+ */
+std::string fen_error_message(const fen_result_t& res,
+                              const std::string_view FEN);
+
+
+/**
+ * Fixed capacity list of the pieces currently on the board, used by the GUI
+ * to draw them without touching the heap.
+ */
+class piece_views_t
+{
+private:
+  std::array<piece_t, MAX_PIECES_PER_SIDE * 2> _pieces;
+  size_t _count = 0;
+
+public:
+  inline void push_back(const piece_t& p) { _pieces[_count++] = p; }
+
+  inline size_t size() const { return _count; }
+  inline const piece_t* begin() const { return _pieces.data(); }
+  inline const piece_t* end() const { return _pieces.data() + _count; }
+};
+
+
+struct packed_position_t;
+
+
+/**
+ * Which moves to generate
+ */
+enum class gen_t
+{
+  ALL,
+  CAPTURES,  // Captures and promotions
+  QUIETS     // Everything else
+};
+
+
+/**
+ * Everything make_move can't recompute when taking a move back
+ */
+struct undo_t
+{
+  move_t move;
+  uint8_t captured;
+  uint8_t captured_slot;
+  uint8_t available_castling;
+  uint8_t en_passant_square;
+  int halfmove_clock;
+  uint64_t key;
+};
+
+
+/**
+ * The undo records of the moves played since the last load. A copy only
+ * copies the records in use, so copying a board costs the length of its
+ * history and not MAX_GAME_PLY records.
+ */
+class undo_stack_t
+{
+private:
+  std::array<undo_t, MAX_GAME_PLY> _records;
+  size_t _size = 0;
+
+public:
+  undo_stack_t() = default;
+
+  undo_stack_t(const undo_stack_t& other) : _size(other._size)
+  {
+    std::copy_n(other._records.begin(), _size, _records.begin());
+  }
+
+  undo_stack_t& operator=(const undo_stack_t& other)
+  {
+    _size = other._size;
+    std::copy_n(other._records.begin(), _size, _records.begin());
+    return *this;
+  }
+
+  inline size_t size() const { return _size; }
+  inline void clear() { _size = 0; }
+
+  inline undo_t& push()
+  {
+    assert(_size < MAX_GAME_PLY);
+    return _records[_size++];
+  }
+
+  /**
+   * The record stays valid until the next push
+   */
+  inline const undo_t& pop()
+  {
+    assert(_size > 0);
+    return _records[--_size];
+  }
+
+  /**
+   * The i-th record from the top, 1 is the last move played
+   */
+  inline const undo_t& back(const size_t i) const
+  {
+    assert(i > 0 && i <= _size);
+    return _records[_size - i];
+  }
+
+  /**
+   * Drop everything but the last keep records
+   */
+  inline void keep_last(const size_t keep)
+  {
+    if (keep >= _size) { return; }
+
+    std::move(_records.begin() + (_size - keep), _records.begin() + _size,
+              _records.begin());
+    _size = keep;
+  }
+};
+
+
+/**
+ * The board is a value, it owns no heap memory. Copies only take the undo
+ * records in use, see undo_stack_t.
+ *
+ * Every square of the 0x88 array is one byte: the low nibble is the piece
+ * code (see piece.hpp) and the high nibble is the slot of the piece in the
+ * piece list of its side. The piece lists map every slot back to the square
+ * index so we can iterate the pieces of one side without scanning the board.
+ * The king is always kept in slot 0.
+ *
+ * Next to the mailbox the board keeps one bitboard per piece type and one
+ * per color, always in sync, for the move generator and the attack tests.
+ * The piece-square score, the game phase and the pawn key are kept in sync
+ * the same way for the evaluation.
+ */
 class board_t
 {
 private:
-  std::array<std::shared_ptr<piece_t>, BOARD_ARRAY_SIZE> _board = {0};
+  std::array<uint8_t, BOARD_ARRAY_SIZE> _board = {0};
+  std::array<std::array<uint8_t, MAX_PIECES_PER_SIDE>, 2> _piece_list = {};
+  std::array<uint8_t, 2> _piece_count = {0};
+  std::array<bitboard_t, 7> _type_bb = {0};
+  std::array<bitboard_t, 2> _color_bb = {0};
   color_t _active_color = color_t::WHITE;
   uint8_t _available_castling = WQ | WK | BQ | BK;
-  std::string _en_passant_target_square = "-";
+  uint8_t _en_passant_square = NO_SQUARE;
   int _halfmove_clock = 0;
   int _full_move = 0;
+  uint64_t _key = 0;
+
+  // Evaluation terms, see psqt.hpp
+  score_t _psqt;
+  int _phase = 0;
+  uint64_t _pawn_key = 0;
+
+  // Undo records of the moves played since the last load
+  undo_stack_t _history;
 
   void cleanup();
 
+  uint64_t compute_key() const;
+
+  // parse() without the reset on error
+  fen_result_t parse_fields(const std::string_view FEN,
+                            const bool clocks_optional) noexcept;
+
+  fen_error_t add_piece(const uint8_t index, const uint8_t p);
+
+  void generate_pseudo_legal_moves(move_list_t& list, const gen_t type) const;
+
+  /**
+   * The en passant square, if any, is empty, on the third rank of the side
+   * that just moved and right behind one of its pawns
+   */
+  bool en_passant_valid() const;
+
+  /**
+   * The side that just moved can't have left its king in check
+   */
+  inline bool opponent_in_check() const
+  {
+    return is_square_attacked(king_square(opposite(_active_color)),
+                              _active_color);
+  }
+  void filter_legal(const move_list_t& pseudo_legal, move_list_t& list);
+
+
+  inline void toggle_bb(const uint8_t index, const uint8_t p)
+  {
+    const bitboard_t b = square_bb(to_sq64(index));
+    _type_bb[piece_type(p)] ^= b;
+    _color_bb[static_cast<int>(piece_color(p))] ^= b;
+  }
+
+
+  /**
+   * Evaluation terms of a piece entering or leaving the square
+   */
+  inline void add_terms(const uint8_t index, const uint8_t p)
+  {
+    _psqt += psqt::of(p, to_sq64(index));
+    _phase += psqt::PHASE_WEIGHTS[piece_type(p)];
+    if (piece_type(p) == PAWN) {
+      _pawn_key ^= zobrist::KEYS.piece_square[p][index];
+    }
+  }
+
+  inline void remove_terms(const uint8_t index, const uint8_t p)
+  {
+    _psqt -= psqt::of(p, to_sq64(index));
+    _phase -= psqt::PHASE_WEIGHTS[piece_type(p)];
+    if (piece_type(p) == PAWN) {
+      _pawn_key ^= zobrist::KEYS.piece_square[p][index];
+    }
+  }
+
+
+  /**
+   * Replace the piece on the square keeping its slot (promotions)
+   */
+  inline void change_piece(const uint8_t index, const uint8_t p)
+  {
+    const uint8_t old = _board[index] & PIECE_MASK;
+    toggle_bb(index, old);
+    remove_terms(index, old);
+    _board[index] = (_board[index] & 0xF0) | p;
+    toggle_bb(index, p);
+    add_terms(index, p);
+  }
+
+
+  /**
+   * Take the piece off the board and return the slot it had in the piece list
+   */
+  inline uint8_t remove_piece(const uint8_t index)
+  {
+    const uint8_t p = _board[index] & PIECE_MASK;
+    const uint8_t slot = _board[index] >> 4;
+    const int side = static_cast<int>(piece_color(p));
+
+    assert(p != EMPTY);
+    assert(piece_type(p) != KING);
+
+    // Fill the hole with the last piece of the list
+    const uint8_t last = --_piece_count[side];
+    const uint8_t last_index = _piece_list[side][last];
+    _piece_list[side][slot] = last_index;
+    _board[last_index] = (slot << 4) | (_board[last_index] & PIECE_MASK);
+
+    _board[index] = EMPTY;
+    toggle_bb(index, p);
+    remove_terms(index, p);
 
-  inline uint8_t to_index(const uint8_t file, const uint8_t rank)
+    return slot;
+  }
+
+
+  /**
+   * Exact inverse of remove_piece: the piece gets back its slot and the piece
+   * that filled the hole goes back to the end of the list.
+   */
+  inline void restore_piece(const uint8_t index,
+                            const uint8_t p,
+                            const uint8_t slot)
+  {
+    const int side = static_cast<int>(piece_color(p));
+
+    assert(_board[index] == EMPTY);
+
+    const uint8_t last = _piece_count[side]++;
+    const uint8_t moved_index = _piece_list[side][slot];
+    _piece_list[side][last] = moved_index;
+    _board[moved_index] = (last << 4) | (_board[moved_index] & PIECE_MASK);
+
+    _piece_list[side][slot] = index;
+    _board[index] = (slot << 4) | p;
+    toggle_bb(index, p);
+    add_terms(index, p);
+  }
+
+
+  inline void move_piece(const uint8_t from, const uint8_t to)
+  {
+    assert(_board[from] != EMPTY);
+    assert(_board[to] == EMPTY);
+
+    const uint8_t slot = _board[from] >> 4;
+    const int side = static_cast<int>(piece_color(_board[from]));
+
+    _board[to] = _board[from];
+    _board[from] = EMPTY;
+    _piece_list[side][slot] = to;
+
+    const bitboard_t b = square_bb(to_sq64(from)) | square_bb(to_sq64(to));
+    _type_bb[piece_type(_board[to])] ^= b;
+    _color_bb[side] ^= b;
+
+    const uint8_t p = _board[to] & PIECE_MASK;
+    remove_terms(from, p);
+    add_terms(to, p);
+  }
+
+
+public:
+  board_t();
+
+  /**
+   * Load a FEN string. Throws FAN_exception with a detailed message if the
+   * string is not valid.
+   */
+  void load(const std::string_view FEN);
+
+
+  /**
+   * Single pass FEN parser: never throws and allocates nothing. With
+   * clocks_optional the halfmove clock and fullmove number may be missing
+   * (EPD), they default to 0 and 1, and the text after the last field is
+   * left to the caller. On error the board is reset to the starting
+   * position.
+   */
+  fen_result_t parse(const std::string_view FEN,
+                     const bool clocks_optional = false) noexcept;
+
+
+  /**
+   * The position in Forsyth-Edwards Notation
+   */
+  std::string fen() const;
+
+
+  /**
+   * Binary form of the position, see packed.hpp
+   */
+  void pack(packed_position_t& packed) const;
+  fen_error_t unpack(const packed_position_t& packed) noexcept;
+
+
+  static inline uint8_t to_index(const uint8_t file, const uint8_t rank)
   {
-    assert(file >= 0 && file < 8);
-    assert(rank >= 0 && rank < 8);
+    assert(file < 8);
+    assert(rank < 8);
 
     const uint8_t index = (rank << 4) + file;
     assert(index < BOARD_ARRAY_SIZE);
@@ -73,7 +434,7 @@ private:
   }
 
 
-  inline position_t to_position(const uint8_t index)
+  static inline position_t to_position(const uint8_t index)
   {
     position_t result;
     result.file = index & 7;
@@ -83,88 +444,242 @@ private:
   }
 
 
-public:
-  board_t();
+  /**
+   * Play the move from the GUI if it is legal, promoting to queen. Returns
+   * false and leaves the board untouched otherwise.
+   */
+  bool move(const uint8_t from_file,
+            const uint8_t from_rank,
+            const uint8_t to_file,
+            const uint8_t to_rank);
 
-  void load(const std::string& FEN);
 
-  inline void set(const uint8_t file, const uint8_t rank, const char p)
-  {
-    const uint8_t index = to_index(file, rank);
-    _board[index] = std::make_shared<piece_t>(file, rank, p);
-  }
+  /**
+   * Play a pseudo legal move and push its undo record. Updates the side to
+   * move, castling rights, en passant square and the clocks incrementally.
+   */
+  void make_move(const move_t& m);
 
-  inline void move(const uint8_t from_file,
-                   const uint8_t from_rank,
-                   const uint8_t to_file,
-                   const uint8_t to_rank)
-  {
-    print_move(from_file, from_rank, to_file, to_rank);
 
-    assert(from_rank != to_rank || from_file != to_file);
+  /**
+   * Take back the last move played with make_move
+   */
+  void unmake_move();
 
-    const uint8_t from_index = to_index(from_file, from_rank);
-    const uint8_t dest_index = to_index(to_file, to_rank);
 
-    assert(_board[from_index]);
+  /**
+   * Forget the undo records: the moves played so far can't be taken back
+   * anymore. Only safe right after an irreversible move (halfmove clock 0),
+   * otherwise the repetition detection loses positions.
+   */
+  inline void clear_history() { _history.clear(); }
+
+
+  /**
+   * Forget the undo records the repetition detection can't need anymore: the
+   * ones before the last irreversible move and the ones older than the fifty
+   * moves rule. Keeps the history bounded over a game of any length, the
+   * moves dropped can't be taken back.
+   */
+  void trim_history();
+
+
+  /**
+   * Pass the turn. Used by the null move pruning, the position is not legal
+   * chess anymore so only unmake_null_move can follow.
+   */
+  void make_null_move();
+  void unmake_null_move();
+
+
+  /**
+   * Generate all the legal moves of the side to move
+   */
+  void generate_legal_moves(move_list_t& list);
+
+
+  /**
+   * Generate the legal captures and promotions of the side to move
+   */
+  void generate_legal_captures(move_list_t& list);
+
+
+  /**
+   * Generate the legal moves that are neither captures nor promotions
+   */
+  void generate_legal_quiets(move_list_t& list);
 
-    // Unset the current piece
-    _board[dest_index] = _board[from_index];
-    _board[from_index] = nullptr;
-    _board[dest_index].get()->set_index(dest_index);
-    _board[dest_index].get()->set_file(to_file);
-    _board[dest_index].get()->set_rank(to_rank);
-  }
 
+  /**
+   * Rebuild a move from its 16 bit form (see pack_move) in this position.
+   * The result may well be illegal, check it with is_pseudo_legal first.
+   */
+  move_t unpack_move(const uint16_t packed) const;
 
-  inline std::vector<position_t> get_valid_moves(const uint8_t file,
-                                                 const uint8_t rank)
+
+  /**
+   * True if the move could have been generated in this position, the king
+   * may be left in check
+   */
+  bool is_pseudo_legal(const move_t& m) const;
+
+
+  /**
+   * True if the pseudo legal move doesn't leave the king in check
+   */
+  bool is_legal(const move_t& m);
+
+
+  /**
+   * Generate the legal moves of the piece on the given square
+   */
+  void get_valid_moves(const uint8_t file,
+                       const uint8_t rank,
+                       move_list_t& list);
+
+
+  /**
+   * True if the square is attacked by any piece of the given color
+   */
+  bool is_square_attacked(const uint8_t index, const color_t by) const;
+
+
+  inline bool in_check() const
   {
-    std::vector<position_t> result;
+    return is_square_attacked(king_square(_active_color),
+                              opposite(_active_color));
+  }
 
-    const uint8_t index = to_index(file, rank);
 
-    if (_board[index]) {
-      const auto all_moves = _board[index]->get_all_moves();
+  /**
+   * Fifty moves rule, repetition of a position since the last irreversible
+   * move and trivially insufficient material.
+   */
+  bool is_draw() const;
+
 
-      result.reserve(all_moves.size());
-      for (const auto I : all_moves) {
-        result.push_back(to_position(I));
+  inline bool has_non_pawn_material(const color_t c) const
+  {
+    const int side = static_cast<int>(c);
+
+    // Slot 0 is the king
+    for (uint8_t slot = 1; slot < _piece_count[side]; ++slot) {
+      if (piece_type(piece_at(_piece_list[side][slot])) != PAWN) {
+        return true;
       }
     }
 
-    return result;
+    return false;
   }
 
 
-  inline std::vector<std::shared_ptr<piece_t>> pieces() const
+  inline uint8_t piece_count(const color_t c) const
   {
-    std::vector<std::shared_ptr<piece_t>> res;
-    res.reserve(32);
+    return _piece_count[static_cast<int>(c)];
+  }
 
-    for (const auto& I : _board) {
-      if (I) { res.push_back(I); }
+  inline uint8_t piece_square(const color_t c, const uint8_t slot) const
+  {
+    return _piece_list[static_cast<int>(c)][slot];
+  }
+
+
+  inline piece_views_t pieces() const
+  {
+    piece_views_t res;
+
+    for (int side = 0; side < 2; ++side) {
+      for (uint8_t slot = 0; slot < _piece_count[side]; ++slot) {
+        const uint8_t index = _piece_list[side][slot];
+        res.push_back(piece_t(index, _board[index] & PIECE_MASK));
+      }
     }
 
     return res;
   }
 
 
-  inline std::shared_ptr<piece_t> get_piece(const uint8_t file,
-                                          const uint8_t rank)
+  inline piece_t get_piece(const uint8_t file, const uint8_t rank) const
   {
     const uint8_t index = to_index(file, rank);
-    return _board[index];
+    return piece_t(index, _board[index] & PIECE_MASK);
+  }
+
+
+  inline uint8_t piece_at(const uint8_t index) const
+  {
+    return _board[index] & PIECE_MASK;
+  }
+
+  inline bitboard_t pieces_bb(const color_t c, const uint8_t type) const
+  {
+    return _type_bb[type] & _color_bb[static_cast<int>(c)];
+  }
+
+  inline bitboard_t type_bb(const uint8_t type) const { return _type_bb[type]; }
+
+  inline bitboard_t color_bb(const color_t c) const
+  {
+    return _color_bb[static_cast<int>(c)];
+  }
+
+  inline bitboard_t occupied_bb() const { return _color_bb[0] | _color_bb[1]; }
+
+
+  /**
+   * Pieces of both colors attacking the sq64 square with the given occupancy
+   */
+  bitboard_t attackers_to(const uint8_t sq, const bitboard_t occupied) const;
+
+
+  inline uint8_t king_square(const color_t c) const
+  {
+    return _piece_list[static_cast<int>(c)][0];
   }
 
 
   inline color_t active_color() const { return _active_color; }
 
   inline uint8_t available_castling() const { return _available_castling; }
+  inline uint8_t en_passant_square() const { return _en_passant_square; }
   inline std::string en_passant_target_square() const
   {
-    return _en_passant_target_square;
+    if (_en_passant_square == NO_SQUARE) { return "-"; }
+
+    return std::string(1, 'a' + (_en_passant_square & 7)) +
+           std::string(1, '1' + (_en_passant_square >> 4));
   }
   inline int halfmove_clock() const { return _halfmove_clock; }
   inline int full_move() const { return _full_move; }
+  inline size_t ply() const { return _history.size(); }
+
+  /**
+   * Zobrist key of the position. Maintained incrementally by make_move.
+   */
+  inline uint64_t key() const { return _key; }
+
+  /**
+   * Zobrist key of the pawns alone, for the pawn hash table
+   */
+  inline uint64_t pawn_key() const { return _pawn_key; }
+
+  /**
+   * Sum of the piece-square entries of the pieces, white point of view
+   */
+  inline score_t psqt() const { return _psqt; }
+
+  /**
+   * Game phase from psqt::MAX_PHASE (opening) down to 0 (pawn endgame), can
+   * be above the maximum after promotions
+   */
+  inline int phase() const { return _phase; }
+
+  /**
+   * The last move played, NULL_MOVE at the start or after a null move
+   */
+  inline move_t last_move() const
+  {
+    return _history.size() ? _history.back(1).move : NULL_MOVE;
+  }
 };
+
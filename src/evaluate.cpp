@@ -0,0 +1,137 @@
+#include "evaluate.hpp"
+#include <algorithm>
+
+static constexpr score_t DOUBLED_PAWN = {-10, -20};
+static constexpr score_t ISOLATED_PAWN = {-10, -15};
+static constexpr score_t CONNECTED_PAWN = {8, 5};
+
+// By rank from the point of view of the pawn
+static constexpr std::array<score_t, 8> PASSED_PAWN = {
+    score_t{0, 0},   score_t{5, 10},  score_t{10, 15},  score_t{15, 25},
+    score_t{30, 50}, score_t{50, 80}, score_t{80, 120}, score_t{0, 0}};
+
+
+static inline bitboard_t file_bb(const uint8_t file)
+{
+  return FILE_A_BB << file;
+}
+
+
+static inline bitboard_t adjacent_files_bb(const uint8_t file)
+{
+  return (file > 0 ? file_bb(file - 1) : 0) |
+         (file < 7 ? file_bb(file + 1) : 0);
+}
+
+
+/**
+ * The ranks in front of the square for the color. Pawns are never on the
+ * last rank.
+ */
+static inline bitboard_t forward_ranks_bb(const color_t c, const uint8_t sq)
+{
+  const unsigned rank = sq >> 3;
+  return c == color_t::WHITE ? ~0ULL << (8 * (rank + 1))
+                             : (1ULL << (8 * rank)) - 1;
+}
+
+
+score_t evaluate_pawns(const board_t& board)
+{
+  using namespace bitboards;
+
+  score_t score;
+
+  for (const color_t c : {color_t::WHITE, color_t::BLACK}) {
+    const bitboard_t own = board.pieces_bb(c, PAWN);
+    const bitboard_t enemy = board.pieces_bb(opposite(c), PAWN);
+
+    score_t side;
+    bitboard_t b = own;
+    while (b) {
+      const uint8_t sq = pop_lsb(b);
+      const uint8_t file = sq & 7;
+      const uint8_t rank = c == color_t::WHITE ? sq >> 3 : 7 - (sq >> 3);
+      const bitboard_t front = forward_ranks_bb(c, sq);
+      const bitboard_t adjacent = adjacent_files_bb(file);
+
+      if (own & file_bb(file) & front) { side += DOUBLED_PAWN; }
+      if (!(own & adjacent)) { side += ISOLATED_PAWN; }
+
+      if (!(enemy & (file_bb(file) | adjacent) & front)) {
+        side += PASSED_PAWN[rank];
+      }
+
+      // Defended by a pawn or side by side with one
+      const bitboard_t phalanx = own & adjacent & (RANK_1_BB << (sq & 56));
+      if ((pawn_attacks_from(opposite(c), sq) & own) || phalanx) {
+        side += CONNECTED_PAWN;
+      }
+    }
+
+    if (c == color_t::WHITE) {
+      score += side;
+    } else {
+      score -= side;
+    }
+  }
+
+  return score;
+}
+
+
+pawn_table_t::pawn_table_t(const size_t entries)
+{
+  size_t size = 1;
+  while (size < entries) {
+    size <<= 1;
+  }
+
+  _entries.resize(size);
+}
+
+
+score_t pawn_table_t::probe(const board_t& board)
+{
+  const uint64_t key = board.pawn_key();
+  entry_t& e = _entries[key & (_entries.size() - 1)];
+
+  if (e.key != key) {
+    e.key = key;
+    e.score = evaluate_pawns(board);
+  }
+
+  return e.score;
+}
+
+
+void pawn_table_t::clear()
+{
+  std::fill(_entries.begin(), _entries.end(), entry_t{});
+}
+
+
+/**
+ * Blend the midgame and endgame halves, side to move point of view
+ */
+static inline int taper(const board_t& board, const score_t& score)
+{
+  const int phase = std::min(board.phase(), psqt::MAX_PHASE);
+  const int value =
+      (score.mg * phase + score.eg * (psqt::MAX_PHASE - phase)) /
+      psqt::MAX_PHASE;
+
+  return board.active_color() == color_t::WHITE ? value : -value;
+}
+
+
+int evaluate(const board_t& board, pawn_table_t& pawns)
+{
+  return taper(board, board.psqt() + pawns.probe(board));
+}
+
+
+int evaluate(const board_t& board)
+{
+  return taper(board, board.psqt() + evaluate_pawns(board));
+}
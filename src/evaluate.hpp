@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+#include "board.hpp"
+#include "psqt.hpp"
+
+static constexpr std::array<int, 7> PIECE_VALUES = {0,   100, 320, 330,
+                                                    500, 900, 0};
+
+static constexpr size_t PAWN_TABLE_ENTRIES = 1 << 14;
+static_assert((PAWN_TABLE_ENTRIES & (PAWN_TABLE_ENTRIES - 1)) == 0,
+              "The pawn table is indexed with a mask");
+
+
+/**
+ * Pawn structure terms by pawn key. The pawns change in few moves so most
+ * evaluations find their pawn terms here. One table per search thread, no
+ * locking.
+ */
+class pawn_table_t
+{
+private:
+  struct entry_t
+  {
+    uint64_t key = 0;
+    score_t score;
+  };
+
+  std::vector<entry_t> _entries;
+
+public:
+  /**
+   * The size is rounded up to a power of two, the index is a mask of the key
+   */
+  explicit pawn_table_t(const size_t entries = PAWN_TABLE_ENTRIES);
+
+  /**
+   * Pawn structure score of the board, white point of view. Computed and
+   * stored on a miss.
+   */
+  score_t probe(const board_t& board);
+
+  void clear();
+};
+
+
+/**
+ * Pawn structure score from scratch, white point of view
+ */
+score_t evaluate_pawns(const board_t& board);
+
+
+/**
+ * Static evaluation in centipawns from the point of view of the side to move:
+ * the piece-square score maintained by the board plus the pawn structure,
+ * blended between midgame and endgame by the game phase
+ */
+int evaluate(const board_t& board, pawn_table_t& pawns);
+
+/**
+ * Same without pawn table, for one-off evaluations
+ */
+int evaluate(const board_t& board);
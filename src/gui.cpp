@@ -1,4 +1,9 @@
 #include "gui.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
 #include "exceptions.hpp"
 
 
@@ -33,81 +38,318 @@ void gui_t::draw_coordinates()
 }
 
 
-void gui_t::draw_board()
+frame_state_t gui_t::current_frame()
 {
-  // Draw background
-  pixel_t p;
-  p.a = 255;
-
-  bool black = false;
-  for (int y = 0; y < 8; ++y) {
-    for (int x = 0; x < 8; ++x) {
-      if (black) {
-        p.r = 109;
-        p.g = 64;
-        p.b = 24;
-      } else {
-        p.r = 232;
-        p.g = 235;
-        p.b = 239;
-      }
+  frame_state_t res;
+  res.board_key = _board.key();
+  res.flipped = flipped_board;
+  res.show_profile = show_profile;
 
-      draw_rect({x * SQUARE_SIZE, y * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE},
-                p);
-      black = !black;
-    }
+  if (is_mouse_in(BOARD_RECT)) {
+    const int32_t x = (mouse_state().x - BOARD_RECT.x) / SQUARE_SIZE;
+    const int32_t y = (mouse_state().y - BOARD_RECT.y) / SQUARE_SIZE;
+    res.hover = y * 8 + x;
+  }
 
-    black = !black;
+  if (selected_square.selected) {
+    res.selected = selected_square.y * 8 + selected_square.x;
   }
 
-  // Draw selected square and suggestions if any
+  // The mouse position only matters while dragging a piece
+  if (mouse_holding.selected) {
+    res.holding = mouse_holding.selected.index();
+    res.mouse_x = mouse_state().x;
+    res.mouse_y = mouse_state().y;
+  }
+
+  return res;
+}
+
+
+void gui_t::rebuild_board_layer(const frame_state_t& frame)
+{
+  highlight_count = 0;
+
+  // Selected square and suggestions if any
   if (selected_square.selected) {
-    draw_rect(selected_square.rect, 0x33333390);
-
-    // Draw suggestions
-    for (const auto& I : suggested_positions) {
-      const coordinates_t coord = position_to_coordinates(I.file, I.rank);
-      draw_rect({coord.x * SQUARE_SIZE, coord.y * SQUARE_SIZE, SQUARE_SIZE,
-                 SQUARE_SIZE},
-                0x00FF0055);
+    highlights[highlight_count++] = {selected_square.rect, 0x33333390};
+
+    for (const auto& I : suggested_moves) {
+      const position_t pos = board_t::to_position(I.to);
+      const coordinates_t coord = position_to_coordinates(pos.file, pos.rank);
+      highlights[highlight_count++] = {{coord.x * SQUARE_SIZE,
+                                        coord.y * SQUARE_SIZE, SQUARE_SIZE,
+                                        SQUARE_SIZE},
+                                       0x00FF0055};
     }
   }
 
-  // Draw the current square
-  if (is_mouse_in(BOARD_RECT)) {
-    int x = ((mouse_state().x - BOARD_RECT.x) / SQUARE_SIZE);
-    int y = ((mouse_state().y - BOARD_RECT.y) / SQUARE_SIZE);
+  // The current square
+  if (frame.hover >= 0) {
+    const int32_t x = frame.hover % 8;
+    const int32_t y = frame.hover / 8;
+    highlights[highlight_count++] = {
+        {x * SQUARE_SIZE, y * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE},
+        0xAA00FF55};
+  }
+
+  // Pieces, but the selected one that follows the mouse
+  sprite_count = 0;
+  for (const auto& I : _board.pieces()) {
+    if (mouse_holding.selected && mouse_holding.selected.index() == I.index()) {
+      continue;
+    }
+
+    const coordinates_t coord = position_to_coordinates(I.file(), I.rank());
+    sprites[sprite_count++] = {I.c(),
+                               {coord.x * SQUARE_SIZE, coord.y * SQUARE_SIZE,
+                                SQUARE_SIZE, SQUARE_SIZE}};
+  }
+
+  // Draws of the same texture back to back are merged by the renderer
+  std::sort(sprites.begin(), sprites.begin() + sprite_count,
+            [](const sprite_t& a, const sprite_t& b) { return a.c < b.c; });
 
-    draw_rect({x * SQUARE_SIZE, y * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE},
-              0xAA00FF55);
+  has_held_sprite = static_cast<bool>(mouse_holding.selected);
+  if (has_held_sprite) {
+    held_sprite = {mouse_holding.selected.c(),
+                   {frame.mouse_x - mouse_holding.offset_x,
+                    frame.mouse_y - mouse_holding.offset_y, SQUARE_SIZE,
+                    SQUARE_SIZE}};
   }
+}
+
+
+void gui_t::throttle(const bool dirty)
+{
+  idle_frames = dirty ? 0 : idle_frames + 1;
 
-  // Draw pieces
-  const auto pieces = _board.pieces();
-  for (const auto& I : pieces) {
-    const uint8_t file = I.get()->file();
-    const uint8_t rank = I.get()->rank();
+  // Stay responsive for a second after the last change, then slow down
+  if (idle_frames < ACTIVE_FPS) { return; }
 
-    const coordinates_t coord = position_to_coordinates(file, rank);
-    const char c = I.get()->c();
+  std::this_thread::sleep_for(
+      std::chrono::milliseconds(1000 / IDLE_FPS - 1000 / ACTIVE_FPS));
+}
 
-    // Don't draw the selected piece
-    if (mouse_holding.selected.get() == I.get()) { continue; }
 
-    // The pice is in place
-    rect_t r = {coord.x * SQUARE_SIZE, coord.y * SQUARE_SIZE, SQUARE_SIZE,
-                SQUARE_SIZE};
+void gui_t::draw_board()
+{
+  // Static layer: one light rect and the dark squares
+  draw_rect({0, 0, BOARD_RECT.w, BOARD_RECT.h}, LIGHT_SQUARE_COLOR);
+  for (const rect_t& r : DARK_SQUARES) {
+    draw_rect(r, DARK_SQUARE_COLOR);
+  }
 
-    draw_texture(piece_textures[c], r);
+  for (size_t i = 0; i < highlight_count; ++i) {
+    draw_rect(highlights[i].rect, highlights[i].color);
+  }
+
+  for (size_t i = 0; i < sprite_count; ++i) {
+    draw_texture(piece_texture(sprites[i].c), sprites[i].rect);
   }
 
   // For last draw the selected piece
-  if (mouse_holding.selected) {
-    rect_t r = {mouse_state().x - mouse_holding.offset_x,
-                mouse_state().y - mouse_holding.offset_y, SQUARE_SIZE,
-                SQUARE_SIZE};
-    draw_texture(piece_textures[mouse_holding.selected.get()->c()], r);
+  if (has_held_sprite) {
+    draw_texture(piece_texture(held_sprite.c), held_sprite.rect);
+  }
+}
+
+
+void gui_t::update_analysis()
+{
+  // A new position cancels the running search. Waiting for the workers here
+  // would stall the frame, so the search is only asked to stop and the new
+  // one starts on a later frame, once the old one is over.
+  if (!analysis_started || analysis_key.load() != _board.key()) {
+    if (analysis.is_running()) {
+      analysis.stop();
+    } else {
+      analysis_key.store(_board.key());
+
+      search_limits_t limits;
+      limits.depth = ANALYSIS_DEPTH;
+      limits.infinite = true;
+      analysis.start(_board, limits);
+      analysis_started = true;
+    }
+  }
+
+  analysis_snapshot.update();
+}
+
+
+void gui_t::draw_analysis(int32_t y)
+{
+  const analysis_t& a = analysis_snapshot.latest();
+  const search_info_t& info = a.info;
+
+  // Results of an older position are not shown
+  const bool current = a.key == _board.key() && info.depth > 0;
+
+  // Always from the white point of view
+  const int score =
+      _board.active_color() == color_t::WHITE ? info.score : -info.score;
+
+  const texture_t& eval_texture = panel_line(
+      LINE_EVAL, current ? score : VALUE_INFINITE + 1, [&]() -> std::string {
+        if (!current) { return "Eval: -"; }
+        if (info.is_mate()) {
+          const int mate = _board.active_color() == color_t::WHITE
+                               ? info.mate_in()
+                               : -info.mate_in();
+          return "Eval: #" + STR(mate);
+        }
+
+        const std::string sign = score >= 0 ? "+" : "-";
+        const int cp = std::abs(score);
+        const std::string pad = cp % 100 < 10 ? "0" : "";
+        return "Eval: " + sign + STR(cp / 100) + "." + pad + STR(cp % 100);
+      });
+  draw_texture(eval_texture, 10, y);
+  y += eval_texture.h + 10;
+
+  const int depth = current ? info.depth : 0;
+  const texture_t& depth_texture =
+      panel_line(LINE_DEPTH, depth, [depth]() -> std::string {
+        return "Depth: " + (depth ? STR(depth) : std::string("-"));
+      });
+  draw_texture(depth_texture, 10, y);
+  y += depth_texture.h + 10;
+
+  const uint64_t knps = current ? info.nps / 1000 : 0;
+  const texture_t& nps_texture = panel_line(
+      LINE_NPS, static_cast<int64_t>(knps),
+      [knps]() { return "kN/s: " + (knps ? STR(knps) : std::string("-")); });
+  draw_texture(nps_texture, 10, y);
+  y += nps_texture.h + 10;
+
+  // The first moves of the PV, identified by their packed form
+  const int pv_length =
+      current ? std::min(info.pv.length, ANALYSIS_PV_MOVES) : 0;
+  uint64_t pv_id = pv_length;
+  for (int i = 0; i < pv_length; ++i) {
+    pv_id = (pv_id << 16) ^ pack_move(info.pv.moves[i]);
+  }
+
+  const texture_t& pv_texture =
+      panel_line(LINE_PV, static_cast<int64_t>(pv_id), [&]() {
+        std::string pv = "PV:";
+        for (int i = 0; i < pv_length; ++i) {
+          pv += " " + to_string(info.pv.moves[i]);
+        }
+        return pv_length ? pv : pv + " -";
+      });
+  draw_texture(pv_texture, 10, y);
+  y += pv_texture.h + 10;
+
+  draw_book(y);
+}
+
+
+void gui_t::draw_book(int32_t y)
+{
+  if (!book.is_open()) { return; }
+
+  // Looked up again only when the position changes
+  const texture_t& book_texture =
+      panel_line(LINE_BOOK, static_cast<int64_t>(_board.key()), [this]() {
+        std::vector<polyglot::book_move_t> moves;
+        book.moves(_board, moves);
+
+        std::string text = "Book:";
+        for (size_t i = 0; i < moves.size() && i < BOOK_PANEL_MOVES; ++i) {
+          text += " " + to_string(moves[i].move);
+        }
+        return moves.empty() ? text + " -" : text;
+      });
+  draw_texture(book_texture, 10, y);
+}
+
+
+void gui_t::draw_profile()
+{
+  // The text of the overlay is made again a couple of times per second only,
+  // the stats are over all the samples still in the ring
+  if (profile_frames++ % PROFILE_REFRESH_FRAMES == 0) {
+    profile::ring().collect(profile_samples);
+    const auto stats = profile::compute_stats(profile_samples);
+
+    profile_lines[0] = create_text("ms        p50    p99", PROFILE_TEXT_COLOR);
+    for (size_t i = 0; i < profile::SECTIONS; ++i) {
+      char buffer[64];
+      std::snprintf(buffer, sizeof(buffer), "%-11s%6.2f %6.2f",
+                    profile::section_name(static_cast<profile::section_t>(i)),
+                    stats[i].p50_ms, stats[i].p99_ms);
+      profile_lines[i + 1] = create_text(buffer, PROFILE_TEXT_COLOR);
+    }
   }
+
+  const int32_t line_h = profile_lines[0].h + 4;
+  draw_rect({0, 0, BOARD_RECT.w,
+             static_cast<int32_t>(profile_lines.size()) * line_h + 12},
+            PROFILE_BACKGROUND_COLOR);
+
+  int32_t y = 8;
+  for (const texture_t& I : profile_lines) {
+    draw_texture(I, 10, y);
+    y += line_h;
+  }
+}
+
+
+void gui_t::draw_right_panel()
+{
+  int32_t y = 10;
+
+  // Draw turn
+  const color_t turn = _board.active_color();
+  const texture_t& turn_texture =
+      panel_line(LINE_TURN, static_cast<int64_t>(turn), [turn]() {
+        return std::string("Turn: ") + (turn == color_t::WHITE ? "W" : "B");
+      });
+  draw_texture(turn_texture, 10, y);
+  y += turn_texture.h + 10;
+
+  // Draw castling situation
+  const uint8_t available_castling = _board.available_castling();
+  const texture_t& castling_texture =
+      panel_line(LINE_CASTLING, available_castling, [available_castling]() {
+        std::string castling = "Castling: ";
+        if (available_castling & WK) { castling += "K"; }
+        if (available_castling & WQ) { castling += "Q"; }
+        if (available_castling & BK) { castling += "k"; }
+        if (available_castling & BQ) { castling += "q"; }
+        if (available_castling == 0x00) { castling += "-"; }
+        return castling;
+      });
+  draw_texture(castling_texture, 10, y);
+  y += castling_texture.h + 10;
+
+  // Draw en passant target square
+  const texture_t& en_passant_texture =
+      panel_line(LINE_EN_PASSANT, _board.en_passant_square(), [this]() {
+        return "En passant: " + _board.en_passant_target_square();
+      });
+  draw_texture(en_passant_texture, 10, y);
+  y += en_passant_texture.h + 10;
+
+  // Draw the halfmove clock
+  const int halfmove_clock = _board.halfmove_clock();
+  const texture_t& half_clock_texture =
+      panel_line(LINE_HALFMOVE_CLOCK, halfmove_clock,
+                 [halfmove_clock]() { return "HMC: " + STR(halfmove_clock); });
+  draw_texture(half_clock_texture, 10, y);
+  y += half_clock_texture.h + 10;
+
+  // Draw the fullmove counter
+  const int full_move = _board.full_move();
+  const texture_t& full_clock_texture =
+      panel_line(LINE_FULLMOVE, full_move,
+                 [full_move]() { return "FMC: " + STR(full_move); });
+  draw_texture(full_clock_texture, 10, y);
+  y += full_clock_texture.h + 30;
+
+  draw_analysis(y);
 }
 
 
@@ -140,6 +382,13 @@ void gui_t::on_init(void*)
 
   background = load_image("assets/background_l.jpg");
 
+  // The book is optional
+  try {
+    book.open(BOOK_PATH);
+  } catch (const input_exception& e) {
+    LOG_W << "No opening book: " << e.what() << END_W;
+  }
+
   sound_fx[0] = load_sound("assets/sound/tick_1.wav");
   sound_fx[1] = load_sound("assets/sound/tick_2.wav");
   sound_fx[2] = load_sound("assets/sound/tick_3.wav");
@@ -157,12 +406,15 @@ void gui_t::on_init(void*)
 }
 
 
-void gui_t::on_update(void*)
+bool gui_t::update_frame()
 {
+  PROFILE_SCOPE(profile::FRAME);
+
   {
     /***************************************************************************
      * MOUSE
      **************************************************************************/
+    PROFILE_SCOPE(profile::INPUT);
     const auto mouse = mouse_state();
 
     // Reset the board if click on the right panel
@@ -175,6 +427,23 @@ void gui_t::on_update(void*)
       flipped_board = !flipped_board;
     }
 
+    // Toggle the profiler overlay or dump a trace if click on the FPS
+    if (profile::ENABLED && is_mouse_in(FPS_RECT)) {
+      if (mouse.left_button.click) {
+        show_profile = !show_profile;
+        profile_frames = 0;
+      }
+
+      if (mouse.right_button.click) {
+        try {
+          profile::write_chrome_trace(TRACE_PATH);
+          LOG_I << "Profiler trace written to " << TRACE_PATH << END_I;
+        } catch (const input_exception& e) {
+          LOG_W << e.what() << END_W;
+        }
+      }
+    }
+
     if (is_mouse_in(BOARD_RECT)) {
       const uint8_t x = ((mouse.x - BOARD_RECT.x) / SQUARE_SIZE);
       const uint8_t y = ((mouse.y - BOARD_RECT.y) / SQUARE_SIZE);
@@ -183,7 +452,7 @@ void gui_t::on_update(void*)
       auto piece = _board.get_piece(target_pos.file, target_pos.rank);
 
       // Piece holding
-      if (piece != nullptr) {
+      if (piece) {
         if (mouse.left_button.state == button_t::DOWN &&
             !mouse_holding.selected) {
           mouse_holding.offset_x = mouse.x - (x * SQUARE_SIZE);
@@ -197,8 +466,8 @@ void gui_t::on_update(void*)
 
       // Reset the selected state
       if (mouse.left_button.state == button_t::UP && mouse_holding.selected) {
-        const uint8_t f = mouse_holding.selected.get()->file();
-        const uint8_t r = mouse_holding.selected.get()->rank();
+        const uint8_t f = mouse_holding.selected.file();
+        const uint8_t r = mouse_holding.selected.rank();
         const coordinates_t selected = position_to_coordinates(f, r);
 
         if (x != selected.x || y != selected.y) {
@@ -207,20 +476,19 @@ void gui_t::on_update(void*)
           selected_square.x = 0;
           selected_square.y = 0;
           selected_square.rect = {0};
-          suggested_positions.clear();
+          suggested_moves.clear();
         }
 
         // Set the piece to the destination column when release
         const position_t dest = coordinates_to_postion(x, y);
 
-        if (dest.file != mouse_holding.selected.get()->file() ||
-            dest.rank != mouse_holding.selected.get()->rank()) {
-          _board.move(mouse_holding.selected.get()->file(),
-                      mouse_holding.selected.get()->rank(), dest.file,
-                      dest.rank);
+        if (dest.file != mouse_holding.selected.file() ||
+            dest.rank != mouse_holding.selected.rank()) {
+          _board.move(mouse_holding.selected.file(),
+                      mouse_holding.selected.rank(), dest.file, dest.rank);
         }
 
-        mouse_holding.selected = nullptr;
+        mouse_holding.selected = piece_t();
         mouse_holding.offset_x = 0;
         mouse_holding.offset_y = 0;
 
@@ -236,7 +504,7 @@ void gui_t::on_update(void*)
           selected_square.x = 0;
           selected_square.y = 0;
           selected_square.rect = {0};
-          suggested_positions.clear();
+          suggested_moves.clear();
         } else {
           selected_square.x = x;
           selected_square.y = y;
@@ -246,14 +514,33 @@ void gui_t::on_update(void*)
 
           // Get the available moves
           const position_t selected_pos = coordinates_to_postion(x, y);
-          suggested_positions =
-              _board.get_valid_moves(selected_pos.file, selected_pos.rank);
+          _board.get_valid_moves(selected_pos.file, selected_pos.rank,
+                                 suggested_moves);
         }
       }
     }
   }
 
-  const pixel_t text_color = {0x000000FF};
+  /*****************************************************************************
+   * DIRTY CHECK
+   *
+   * The board layer is rebuilt only when the position or the mouse interaction
+   * changed. Idle frames replay the cached lists at a lower frame rate.
+   ****************************************************************************/
+  const frame_state_t frame = current_frame();
+  const bool dirty = first_frame || frame != last_frame;
+
+  if (dirty) {
+    PROFILE_SCOPE(profile::BOARD_LAYER);
+    rebuild_board_layer(frame);
+    last_frame = frame;
+    first_frame = false;
+  }
+
+  {
+    PROFILE_SCOPE(profile::ANALYSIS);
+    update_analysis();
+  }
 
   {
     /***************************************************************************
@@ -261,11 +548,16 @@ void gui_t::on_update(void*)
      **************************************************************************/
     clear_screen({0x000000FF});
     draw_texture(background, {0, 0, SCREEN_W, SCREEN_H});
-    draw_coordinates();
+
+    {
+      PROFILE_SCOPE(profile::DRAW_COORDINATES);
+      draw_coordinates();
+    }
 
     // Print FPS
-    uint32_t fps = FPS();
-    texture_t fps_texture = create_text("FPS: " + STR(fps), text_color);
+    const uint32_t fps = FPS();
+    const texture_t& fps_texture =
+        panel_line(LINE_FPS, fps, [fps]() { return "FPS: " + STR(fps); });
 
     const int32_t x = SCREEN_W - 10 - fps_texture.w;
     const int32_t y =
@@ -280,53 +572,9 @@ void gui_t::on_update(void*)
     /***************************************************************************
      * RIGHT PANEL
      **************************************************************************/
+    PROFILE_SCOPE(profile::RIGHT_PANEL);
     set_current_viewport(RIGHT_PANEL_RECT, {0xEEEEEEFF});
-
-    // Draw turn
-    std::string turn = "Turn: ";
-    switch (_board.active_color()) {
-      case color_t::BLACK:
-        turn += "B";
-        break;
-
-      case color_t::WHITE:
-        turn += "W";
-        break;
-    }
-
-    texture_t turn_texture = create_text(turn, text_color);
-    draw_texture(turn_texture, 10, 10);
-
-    // Draw castling situation
-    std::string castling = "Castling: ";
-    const uint8_t available_castling = _board.available_castling();
-    if (available_castling & WK) { castling += "K"; }
-    if (available_castling & WQ) { castling += "Q"; }
-    if (available_castling & BK) { castling += "k"; }
-    if (available_castling & BQ) { castling += "q"; }
-    if (available_castling == 0x00) { castling += "-"; }
-    texture_t castling_texture = create_text(castling, text_color);
-    draw_texture(castling_texture, 10, turn_texture.h + 20);
-
-    // Draw en passant target square
-    std::string en_passant = "En passant: " + _board.en_passant_target_square();
-    texture_t en_passant_texture = create_text(en_passant, text_color);
-    draw_texture(en_passant_texture, 10,
-                 +turn_texture.h + castling_texture.h + 30);
-
-    // Draw the halfmove clock
-    std::string half_clock = "HMC: " + STR(_board.halfmove_clock());
-    texture_t half_clock_texture = create_text(half_clock, text_color);
-    draw_texture(
-        half_clock_texture, 10,
-        +turn_texture.h + castling_texture.h + en_passant_texture.h + 40);
-
-    // Draw the fullmove counter
-    std::string full_clock = "FMC: " + STR(_board.full_move());
-    texture_t full_clock_texture = create_text(full_clock, text_color);
-    draw_texture(full_clock_texture, 10,
-                 +turn_texture.h + castling_texture.h + en_passant_texture.h +
-                     half_clock_texture.h + 50);
+    draw_right_panel();
   }
 
   {
@@ -334,6 +582,22 @@ void gui_t::on_update(void*)
      * MAIN BOARD
      **************************************************************************/
     set_current_viewport(BOARD_RECT);
-    draw_board();
+
+    {
+      PROFILE_SCOPE(profile::DRAW_BOARD);
+      draw_board();
+    }
+
+    if (show_profile) { draw_profile(); }
   }
+
+  return dirty;
+}
+
+
+void gui_t::on_update(void*)
+{
+  // The sleep of the idle frames stays out of the frame time
+  const bool dirty = update_frame();
+  throttle(dirty);
 }
\ No newline at end of file
@@ -1,8 +1,16 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <map>
 #include <pixello.hpp>
 #include "board.hpp"
 #include "log.hpp"
+#include "polyglot.hpp"
+#include "profiler.hpp"
+#include "search.hpp"
+#include "snapshot.hpp"
+#include "text_cache.hpp"
+#include "tt.hpp"
 #include "utils.hpp"
 
 
@@ -12,11 +20,39 @@ static constexpr rect_t BOARD_RECT = {20, 10, 480, 480};
 static constexpr rect_t RIGHT_PANEL_RECT = {510, 10, 290, 480};
 static constexpr int32_t SQUARE_SIZE = 60;
 
+// Frame rate once nothing has changed for a full second
+static constexpr uint32_t IDLE_FPS = 10;
+static constexpr uint32_t ACTIVE_FPS = 60;
+
+// The background analysis stops at this depth and idles until the next move
+static constexpr int ANALYSIS_DEPTH = 24;
+static constexpr size_t ANALYSIS_TT_MB = 16;
+static constexpr int ANALYSIS_PV_MOVES = 4;
+
+// Opened at startup if present, the heaviest moves are shown in the panel
+static constexpr const char* BOOK_PATH = "assets/book.bin";
+static constexpr size_t BOOK_PANEL_MOVES = 3;
+
+// Click the FPS counter to toggle the profiler overlay, right click to dump
+// the samples as a Chrome trace
+static constexpr rect_t FPS_RECT = {
+    RIGHT_PANEL_RECT.x, RIGHT_PANEL_RECT.y + RIGHT_PANEL_RECT.h,
+    RIGHT_PANEL_RECT.w, static_cast<int32_t>(SCREEN_H) - RIGHT_PANEL_RECT.y -
+                            RIGHT_PANEL_RECT.h};
+static constexpr uint32_t PROFILE_REFRESH_FRAMES = 30;
+static constexpr const char* TRACE_PATH = "chesso_trace.json";
+
+static constexpr uint32_t TEXT_COLOR = 0x000000FF;
+static constexpr uint32_t LIGHT_SQUARE_COLOR = 0xE8EBEFFF;
+static constexpr uint32_t DARK_SQUARE_COLOR = 0x6D4018FF;
+static constexpr uint32_t PROFILE_BACKGROUND_COLOR = 0x000000C0;
+static constexpr uint32_t PROFILE_TEXT_COLOR = 0xFFFFFFFF;
+
 struct piece_holding_t
 {
   int32_t offset_x = 0;
   int32_t offset_y = 0;
-  std::shared_ptr<piece_t> selected;
+  piece_t selected;
 };
 
 
@@ -28,38 +64,211 @@ struct selected_square_t
   rect_t rect;
 };
 
+/**
+ * Everything the board layer is drawn from. While it doesn't change the
+ * draw lists of the last frame are replayed as they are.
+ */
+struct frame_state_t
+{
+  uint64_t board_key = 0;
+  bool flipped = false;
+  int32_t hover = -1;
+  int32_t selected = -1;
+  int32_t holding = -1;
+  int32_t mouse_x = 0;
+  int32_t mouse_y = 0;
+  bool show_profile = false;
+
+  inline bool operator==(const frame_state_t& o) const
+  {
+    return board_key == o.board_key && flipped == o.flipped &&
+           hover == o.hover && selected == o.selected &&
+           holding == o.holding && mouse_x == o.mouse_x &&
+           mouse_y == o.mouse_y && show_profile == o.show_profile;
+  }
+
+  inline bool operator!=(const frame_state_t& o) const { return !(*this == o); }
+};
+
+
+struct highlight_t
+{
+  rect_t rect;
+  pixel_t color;
+};
+
+
+struct sprite_t
+{
+  char c;
+  rect_t rect;
+};
+
+
+enum panel_line_id_t
+{
+  LINE_TURN,
+  LINE_CASTLING,
+  LINE_EN_PASSANT,
+  LINE_HALFMOVE_CLOCK,
+  LINE_FULLMOVE,
+  LINE_FPS,
+  LINE_EVAL,
+  LINE_DEPTH,
+  LINE_NPS,
+  LINE_PV,
+  LINE_BOOK,
+  PANEL_LINES
+};
+
+
+/**
+ * A text line of the panel and the value it was rendered from
+ */
+struct panel_line_t
+{
+  bool valid = false;
+  int64_t value = 0;
+  texture_t texture;
+};
+
+
+/**
+ * Last iteration of the background search and the position it belongs to
+ */
+struct analysis_t
+{
+  uint64_t key = 0;
+  search_info_t info;
+};
+
+
+/**
+ * The dark squares over a single light rect. The pattern is the same with
+ * the board flipped so it is computed once.
+ */
+static constexpr std::array<rect_t, 32> make_dark_squares()
+{
+  std::array<rect_t, 32> res = {};
+  size_t i = 0;
+
+  for (int32_t y = 0; y < 8; ++y) {
+    for (int32_t x = (y + 1) % 2; x < 8; x += 2) {
+      res[i++] = {x * SQUARE_SIZE, y * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
+    }
+  }
+
+  return res;
+}
+
+static constexpr std::array<rect_t, 32> DARK_SQUARES = make_dark_squares();
+
+
 class gui_t : public pixello
 {
 private:
   texture_t background;
-  std::map<char, texture_t> piece_textures;
+  // Indexed by the FEN char of the piece
+  std::array<texture_t, 128> piece_textures;
   std::map<char, sound_t> sound_fx;
   board_t _board;
   piece_holding_t mouse_holding;
   selected_square_t selected_square;
-  std::vector<position_t> suggested_positions;
+  move_list_t suggested_moves;
   bool flipped_board = false;
   std::map<char, texture_t> files_and_ranks_textures;
 
+  // Retained draw lists of the board layer, rebuilt only when dirty
+  frame_state_t last_frame;
+  bool first_frame = true;
+  uint32_t idle_frames = 0;
+  std::array<highlight_t, 66> highlights;
+  size_t highlight_count = 0;
+  std::array<sprite_t, MAX_PIECES_PER_SIDE * 2> sprites;
+  size_t sprite_count = 0;
+  sprite_t held_sprite;
+  bool has_held_sprite = false;
+
+  text_cache_t text_cache;
+  std::array<panel_line_t, PANEL_LINES> panel_lines;
+
+  // Background analysis. The search thread publishes, on_update() reads
+  transposition_table_t analysis_tt{ANALYSIS_TT_MB};
+  snapshot_t<analysis_t> analysis_snapshot;
+  std::atomic<uint64_t> analysis_key{0};
+  search_t analysis{analysis_tt};
+  bool analysis_started = false;
+
+  polyglot::book_t book;
+
+  // Profiler overlay, the lines are made again every PROFILE_REFRESH_FRAMES
+  bool show_profile = false;
+  uint32_t profile_frames = 0;
+  std::vector<profile::sample_t> profile_samples;
+  std::array<texture_t, profile::SECTIONS + 1> profile_lines;
+
 public:
   gui_t()
       : pixello(SCREEN_W,
                 SCREEN_H,
                 "Chesso",
-                60,
+                ACTIVE_FPS,
                 "assets/font/PressStart2P.ttf",
                 8)
-  {}
+  {
+    analysis.on_info = [this](const search_info_t& info) {
+      analysis_snapshot.publish(
+          {analysis_key.load(std::memory_order_relaxed), info});
+    };
+  }
 
 private:
+  frame_state_t current_frame();
+  void rebuild_board_layer(const frame_state_t& frame);
+  void throttle(const bool dirty);
+  void update_analysis();
+  void draw_right_panel();
+  void draw_analysis(int32_t y);
+  void draw_book(int32_t y);
   void draw_board();
   void draw_coordinates();
+  void draw_profile();
+  bool update_frame();
 
   void on_init(void*) override;
   void on_update(void*) override;
 
   inline void log(const std::string& msg) override { LOG_E << msg << END_E; }
 
+  /**
+   * The texture of a panel line, the text is made again only when the value
+   * it shows changed
+   */
+  template <typename F>
+  const texture_t& panel_line(const panel_line_id_t id,
+                              const int64_t value,
+                              F&& make_text)
+  {
+    panel_line_t& line = panel_lines[id];
+
+    if (!line.valid || line.value != value) {
+      line.texture = text_cache.get(
+          make_text(), TEXT_COLOR,
+          [this](const std::string& text, const pixel_t& color) {
+            return create_text(text, color);
+          });
+      line.value = value;
+      line.valid = true;
+    }
+
+    return line.texture;
+  }
+
+  inline const texture_t& piece_texture(const char c) const
+  {
+    return piece_textures[static_cast<unsigned char>(c) & 0x7F];
+  }
+
   inline position_t coordinates_to_postion(const uint8_t x, const uint8_t y)
   {
     position_t result;
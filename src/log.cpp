@@ -0,0 +1,224 @@
+#include "log.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace logging {
+
+// The writer sleeps at most this long when a wake up is missed
+static constexpr auto IDLE_WAIT = std::chrono::milliseconds(50);
+
+
+/**
+ * Multi producer single consumer intrusive queue (Vyukov). A producer
+ * appends with one atomic exchange and never waits, the consumer may see a
+ * line a little later while a producer is between its two stores.
+ */
+class queue_t
+{
+private:
+  struct node_t
+  {
+    std::atomic<node_t*> next{nullptr};
+    level_t level = INFO;
+    std::string text;
+  };
+
+  alignas(64) std::atomic<node_t*> _head;
+  alignas(64) node_t* _tail;  // Consumer side
+
+public:
+  queue_t() : _head(new node_t), _tail(_head.load()) {}
+
+  ~queue_t()
+  {
+    level_t level;
+    std::string text;
+    while (pop(level, text)) {}
+    delete _tail;
+  }
+
+  queue_t(const queue_t&) = delete;
+  queue_t& operator=(const queue_t&) = delete;
+
+  void push(const level_t level, std::string&& text)
+  {
+    node_t* node = new node_t;
+    node->level = level;
+    node->text = std::move(text);
+
+    node_t* prev = _head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  /**
+   * Consumer only
+   */
+  bool pop(level_t& level, std::string& text)
+  {
+    node_t* tail = _tail;
+    node_t* next = tail->next.load(std::memory_order_acquire);
+    if (!next) { return false; }
+
+    // next becomes the new dummy node
+    level = next->level;
+    text = std::move(next->text);
+    _tail = next;
+    delete tail;
+
+    return true;
+  }
+};
+
+
+class logger_t
+{
+private:
+  queue_t _queue;
+  alignas(64) std::atomic<uint64_t> _queued{0};
+  alignas(64) std::atomic<uint64_t> _written{0};
+  std::atomic<bool> _sleeping{false};
+  std::atomic<bool> _stop{false};
+
+  std::mutex _mutex;
+  std::condition_variable _wake;     // Writer, something was queued
+  std::condition_variable _drained;  // flush(), the writer caught up
+
+  // Both only touched by the writer or under the mutex
+  std::mutex _sink_mutex;
+  std::ostream* _console = &std::cout;
+  std::ofstream _file;
+
+  std::thread _thread;
+
+  void write(const level_t level, const std::string& text)
+  {
+    static constexpr const char* COLORS[] = {"", "\033[92m", "\033[33m",
+                                             "\033[31m"};
+    static constexpr const char* TAGS[] = {"[I] ", "[S] ", "[W] ", "[E] "};
+
+    if (_console && level == INFO) {
+      *_console << text << '\n';
+    } else if (_console) {
+      *_console << COLORS[level] << text << "\033[37m\n";
+    }
+
+    if (_file.is_open()) { _file << TAGS[level] << text << '\n'; }
+  }
+
+  void run()
+  {
+    level_t level;
+    std::string text;
+
+    for (;;) {
+      uint64_t written = 0;
+      {
+        std::lock_guard<std::mutex> lock(_sink_mutex);
+        while (_queue.pop(level, text)) {
+          write(level, text);
+          ++written;
+        }
+
+        if (written) {
+          if (_console) { _console->flush(); }
+          if (_file.is_open()) { _file.flush(); }
+        }
+      }
+
+      if (written) {
+        _written.fetch_add(written, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _drained.notify_all();
+        continue;
+      }
+
+      if (_stop.load(std::memory_order_acquire) &&
+          _written.load() >= _queued.load()) {
+        return;
+      }
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      _sleeping.store(true, std::memory_order_seq_cst);
+      if (_written.load() >= _queued.load() && !_stop.load()) {
+        _wake.wait_for(lock, IDLE_WAIT);
+      }
+      _sleeping.store(false, std::memory_order_relaxed);
+    }
+  }
+
+public:
+  logger_t() : _thread([this]() { run(); }) {}
+
+  ~logger_t()
+  {
+    _stop.store(true, std::memory_order_release);
+    _wake.notify_one();
+    _thread.join();
+  }
+
+  void submit(const level_t level, std::string&& text)
+  {
+    _queue.push(level, std::move(text));
+    _queued.fetch_add(1, std::memory_order_seq_cst);
+
+    // Only an idle writer needs the wake up
+    if (_sleeping.load(std::memory_order_seq_cst)) { _wake.notify_one(); }
+  }
+
+  void flush()
+  {
+    const uint64_t target = _queued.load();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wake.notify_one();
+    _drained.wait(lock, [this, target]() {
+      return _written.load(std::memory_order_acquire) >= target;
+    });
+  }
+
+  void set_console(std::ostream* console)
+  {
+    std::lock_guard<std::mutex> lock(_sink_mutex);
+    if (_console) { _console->flush(); }
+    _console = console;
+  }
+
+  bool set_file(const std::string& path)
+  {
+    std::lock_guard<std::mutex> lock(_sink_mutex);
+
+    _file.close();
+    if (path.empty()) { return true; }
+
+    _file.open(path, std::ios::trunc);
+    return _file.is_open();
+  }
+};
+
+
+static logger_t& logger()
+{
+  static logger_t instance;
+  return instance;
+}
+
+
+void set_console(std::ostream* console) { logger().set_console(console); }
+
+
+bool set_file(const std::string& path) { return logger().set_file(path); }
+
+
+void submit(const level_t level, std::string text)
+{
+  logger().submit(level, std::move(text));
+}
+
+
+void flush() { logger().flush(); }
+
+}  // namespace logging
@@ -1,14 +1,140 @@
 #pragma once
-#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
 
-#define LOG_I std::cout                 // Start log 
-#define END_I std::endl                 // End log
+// Levels below this one are compiled out, see CHESSO_LOG_LEVEL in CMake
+#if !defined(CHESSO_LOG_LEVEL)
+#define CHESSO_LOG_LEVEL 0
+#endif
 
-#define LOG_S LOG_I << "\033[92m"       // Success green log
-#define END_S "\033[37m" << END_I       // End success green log
 
-#define LOG_W LOG_I << "\033[33m"       // Warning orange log
-#define END_W "\033[37m" << END_I       // End warning orange log
+/*******************************************************************************
+ * Asynchronous logger
+ *
+ *   LOG_I << "Loaded " << n << " positions" << END_I;
+ *
+ * The line is formatted by the caller and pushed to a lock-free queue, a
+ * background thread writes it to the console and to the log file if any.
+ * Logging never waits for the terminal or the disk.
+ *
+ * A line under the compile time level is dead code, one under the runtime
+ * level costs a relaxed load and is never formatted.
+ ******************************************************************************/
+namespace logging {
 
-#define LOG_E LOG_I << "\033[31m"       // Error red log
-#define END_E "\033[37m" << END_I       // End Error red log
\ No newline at end of file
+enum level_t : uint8_t
+{
+  INFO,
+  SUCCESS,
+  WARNING,
+  ERROR,
+  OFF
+};
+
+
+static constexpr level_t COMPILED_LEVEL =
+    static_cast<level_t>(CHESSO_LOG_LEVEL);
+
+inline std::atomic<uint8_t> runtime_level{INFO};
+
+
+inline bool enabled(const level_t level)
+{
+  return level >= COMPILED_LEVEL &&
+         level >= runtime_level.load(std::memory_order_relaxed);
+}
+
+
+inline void set_level(const level_t level)
+{
+  runtime_level.store(level, std::memory_order_relaxed);
+}
+
+
+/**
+ * Also write the log to the file, truncated. An empty path closes it. False
+ * if the file can't be opened.
+ */
+bool set_file(const std::string& path);
+
+
+/**
+ * Where the console output goes, std::cout by default, nowhere if null
+ */
+void set_console(std::ostream* console);
+
+
+/**
+ * Queue a formatted line, for the macros below
+ */
+void submit(const level_t level, std::string text);
+
+
+/**
+ * Wait until every line queued so far is written. The queue is flushed at
+ * exit as well.
+ */
+void flush();
+
+
+struct end_t
+{};
+
+static constexpr end_t end = {};
+
+
+/**
+ * A line being formatted, queued by end or when the statement is over
+ */
+class line_t
+{
+private:
+  const level_t _level;
+  std::ostringstream _stream;
+  bool _submitted = false;
+
+public:
+  explicit line_t(const level_t level) : _level(level) {}
+
+  ~line_t()
+  {
+    if (!_submitted) { submit(_level, _stream.str()); }
+  }
+
+  line_t(const line_t&) = delete;
+  line_t& operator=(const line_t&) = delete;
+
+  template <typename T>
+  inline line_t& operator<<(const T& value)
+  {
+    _stream << value;
+    return *this;
+  }
+
+  inline line_t& operator<<(const end_t&)
+  {
+    if (!_submitted) { submit(_level, _stream.str()); }
+    _submitted = true;
+    return *this;
+  }
+};
+
+}  // namespace logging
+
+
+#define LOG_AT(level) \
+  if (!logging::enabled(level)) {} else logging::line_t(level)
+
+#define LOG_I LOG_AT(logging::INFO)     // Start log
+#define END_I logging::end              // End log
+
+#define LOG_S LOG_AT(logging::SUCCESS)  // Success green log
+#define END_S logging::end              // End success green log
+
+#define LOG_W LOG_AT(logging::WARNING)  // Warning orange log
+#define END_W logging::end              // End warning orange log
+
+#define LOG_E LOG_AT(logging::ERROR)    // Error red log
+#define END_E logging::end              // End Error red log
@@ -0,0 +1,85 @@
+#include "mapped_file.hpp"
+#include <fstream>
+#include "exceptions.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CHESSO_HAS_MMAP
+#endif
+
+
+void mapped_file_t::release()
+{
+#if defined(CHESSO_HAS_MMAP)
+  if (_mapped) { munmap(const_cast<char*>(_data), _size); }
+#endif
+
+  _buffer.clear();
+  _data = nullptr;
+  _size = 0;
+  _mapped = false;
+}
+
+
+void mapped_file_t::open(const std::string& path)
+{
+  release();
+
+#if defined(CHESSO_HAS_MMAP)
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) { throw input_exception("Can't open " + path); }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw input_exception("Can't stat " + path);
+  }
+
+  _size = static_cast<size_t>(st.st_size);
+
+  // mmap refuses empty files, an empty view is fine
+  if (_size > 0) {
+    void* memory = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory == MAP_FAILED) {
+      ::close(fd);
+      _size = 0;
+      throw input_exception("Can't map " + path);
+    }
+
+    _data = static_cast<const char*>(memory);
+    _mapped = true;
+  }
+
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) { throw input_exception("Can't open " + path); }
+
+  _buffer.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(_buffer.data(), _buffer.size());
+
+  _data = _buffer.data();
+  _size = _buffer.size();
+#endif
+}
+
+
+void mapped_file_t::advise_sequential() const
+{
+#if defined(CHESSO_HAS_MMAP)
+  if (_mapped) { madvise(const_cast<char*>(_data), _size, MADV_SEQUENTIAL); }
+#endif
+}
+
+
+void mapped_file_t::advise_random() const
+{
+#if defined(CHESSO_HAS_MMAP)
+  if (_mapped) { madvise(const_cast<char*>(_data), _size, MADV_RANDOM); }
+#endif
+}
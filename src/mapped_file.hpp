@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/**
+ * Read only view of a whole file. On POSIX systems the file is memory mapped
+ * so even huge inputs cost no copy and no heap, elsewhere it is read in one
+ * go. Throws input_exception if the file can't be opened.
+ */
+class mapped_file_t
+{
+private:
+  const char* _data = nullptr;
+  size_t _size = 0;
+  bool _mapped = false;
+  std::vector<char> _buffer;  // Fallback when mmap is not available
+
+  void release();
+
+public:
+  mapped_file_t() = default;
+  explicit mapped_file_t(const std::string& path) { open(path); }
+  ~mapped_file_t() { release(); }
+
+  mapped_file_t(const mapped_file_t&) = delete;
+  mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+  void open(const std::string& path);
+  inline void close() { release(); }
+
+  /**
+   * Hint the kernel about the access pattern, no-op if not mapped
+   */
+  void advise_sequential() const;
+  void advise_random() const;
+
+  inline const char* data() const { return _data; }
+  inline size_t size() const { return _size; }
+  inline bool empty() const { return _size == 0; }
+  inline std::string_view view() const { return {_data, _size}; }
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include "piece.hpp"
+
+static constexpr size_t MAX_MOVES = 256;
+
+static constexpr uint8_t MOVE_QUIET = 0b0000000;
+static constexpr uint8_t MOVE_CAPTURE = 0b0000001;
+static constexpr uint8_t MOVE_DOUBLE_PUSH = 0b0000010;
+static constexpr uint8_t MOVE_EN_PASSANT = 0b0000100;
+static constexpr uint8_t MOVE_CASTLING = 0b0001000;
+
+
+/**
+ * A move between two 0x88 squares. The promotion is the uncolored piece type
+ * (KNIGHT - QUEEN) or EMPTY. The members are not initialized on purpose so a
+ * move list can live on the stack without being filled first.
+ */
+struct move_t
+{
+  uint8_t from;
+  uint8_t to;
+  uint8_t promotion;
+  uint8_t flags;
+
+  inline bool is_capture() const { return flags & MOVE_CAPTURE; }
+  inline bool is_promotion() const { return promotion != EMPTY; }
+
+  inline bool operator==(const move_t& o) const
+  {
+    return from == o.from && to == o.to && promotion == o.promotion;
+  }
+  inline bool operator!=(const move_t& o) const { return !(*this == o); }
+};
+
+
+static constexpr move_t NULL_MOVE = {0, 0, EMPTY, MOVE_QUIET};
+
+
+/**
+ * Fixed capacity list of moves. No position has more than 218 legal moves so
+ * 256 entries are always enough and the list never touches the heap.
+ */
+class move_list_t
+{
+private:
+  std::array<move_t, MAX_MOVES> _moves;
+  size_t _count = 0;
+
+public:
+  inline void push_back(const move_t& m)
+  {
+    assert(_count < MAX_MOVES);
+    _moves[_count++] = m;
+  }
+
+  inline void clear() { _count = 0; }
+  inline size_t size() const { return _count; }
+  inline bool empty() const { return _count == 0; }
+
+  inline move_t& operator[](const size_t i) { return _moves[i]; }
+  inline const move_t& operator[](const size_t i) const { return _moves[i]; }
+
+  inline move_t* begin() { return _moves.data(); }
+  inline move_t* end() { return _moves.data() + _count; }
+  inline const move_t* begin() const { return _moves.data(); }
+  inline const move_t* end() const { return _moves.data() + _count; }
+};
+
+
+/**
+ * 16 bit form used by the transposition table: from and to as 0 - 63 squares
+ * and the promotion type. The flags are recovered from the position when the
+ * move is used again. 0 is no move.
+ */
+static constexpr uint16_t NO_PACKED_MOVE = 0;
+
+inline uint16_t pack_move(const move_t& m)
+{
+  const uint16_t from = (m.from + (m.from & 7)) >> 1;
+  const uint16_t to = (m.to + (m.to & 7)) >> 1;
+
+  return from | (to << 6) | (m.promotion << 12);
+}
+
+
+/**
+ * Long algebraic notation as used by UCI: e2e4, e7e8q
+ */
+inline std::string to_string(const move_t& m)
+{
+  if (m == NULL_MOVE) { return "0000"; }
+
+  std::string res;
+  res.reserve(5);
+  res += static_cast<char>('a' + (m.from & 7));
+  res += static_cast<char>('1' + (m.from >> 4));
+  res += static_cast<char>('a' + (m.to & 7));
+  res += static_cast<char>('1' + (m.to >> 4));
+  if (m.is_promotion()) {
+    res += piece_to_char(m.promotion | BLACK_PIECE);
+  }
+
+  return res;
+}
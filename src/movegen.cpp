@@ -0,0 +1,437 @@
+#include <array>
+#include "board.hpp"
+
+
+static constexpr std::array<uint8_t, 4> promotions = {QUEEN, ROOK, BISHOP,
+                                                      KNIGHT};
+
+// Castling squares
+static constexpr uint8_t A1 = 0x00;
+static constexpr uint8_t B1 = 0x01;
+static constexpr uint8_t C1 = 0x02;
+static constexpr uint8_t D1 = 0x03;
+static constexpr uint8_t E1 = 0x04;
+static constexpr uint8_t F1 = 0x05;
+static constexpr uint8_t G1 = 0x06;
+static constexpr uint8_t H1 = 0x07;
+static constexpr uint8_t RANK_8 = 0x70;
+
+
+/**
+ * The generator works on sq64 squares, the moves keep the 0x88 indexes
+ */
+static inline void push_move(move_list_t& list,
+                             const uint8_t from,
+                             const uint8_t to,
+                             const uint8_t flags,
+                             const bool promotion = false)
+{
+  const uint8_t from88 = to_index88(from);
+  const uint8_t to88 = to_index88(to);
+
+  if (promotion) {
+    for (const uint8_t p : promotions) {
+      list.push_back({from88, to88, p, flags});
+    }
+  } else {
+    list.push_back({from88, to88, EMPTY, flags});
+  }
+}
+
+
+static inline void push_targets(move_list_t& list,
+                                const uint8_t from,
+                                bitboard_t targets,
+                                const bitboard_t enemy)
+{
+  while (targets) {
+    const uint8_t to = pop_lsb(targets);
+    push_move(list, from, to,
+              (enemy & square_bb(to)) ? MOVE_CAPTURE : MOVE_QUIET);
+  }
+}
+
+
+/**
+ * Pawn moves of a whole set at once, delta is the shift from the origin
+ */
+static inline void push_pawn_moves(move_list_t& list,
+                                   bitboard_t targets,
+                                   const int delta,
+                                   const uint8_t flags,
+                                   const bitboard_t last_rank)
+{
+  while (targets) {
+    const uint8_t to = pop_lsb(targets);
+    push_move(list, to - delta, to, flags, square_bb(to) & last_rank);
+  }
+}
+
+
+bitboard_t board_t::attackers_to(const uint8_t sq,
+                                 const bitboard_t occupied) const
+{
+  using namespace bitboards;
+
+  return (pawn_attacks_from(color_t::WHITE, sq) &
+          pieces_bb(color_t::BLACK, PAWN)) |
+         (pawn_attacks_from(color_t::BLACK, sq) &
+          pieces_bb(color_t::WHITE, PAWN)) |
+         (knight_attacks[sq] & _type_bb[KNIGHT]) |
+         (king_attacks[sq] & _type_bb[KING]) |
+         (bishop_attacks(sq, occupied) &
+          (_type_bb[BISHOP] | _type_bb[QUEEN])) |
+         (rook_attacks(sq, occupied) & (_type_bb[ROOK] | _type_bb[QUEEN]));
+}
+
+
+bool board_t::is_square_attacked(const uint8_t index, const color_t by) const
+{
+  using namespace bitboards;
+
+  const uint8_t sq = to_sq64(index);
+  const bitboard_t occupied = occupied_bb();
+
+  // Pawns attack the square from where a pawn of the other color would attack
+  return (pawn_attacks_from(opposite(by), sq) & pieces_bb(by, PAWN)) ||
+         (knight_attacks[sq] & pieces_bb(by, KNIGHT)) ||
+         (king_attacks[sq] & pieces_bb(by, KING)) ||
+         (bishop_attacks(sq, occupied) &
+          (pieces_bb(by, BISHOP) | pieces_bb(by, QUEEN))) ||
+         (rook_attacks(sq, occupied) &
+          (pieces_bb(by, ROOK) | pieces_bb(by, QUEEN)));
+}
+
+
+void board_t::generate_pseudo_legal_moves(move_list_t& list,
+                                          const gen_t type) const
+{
+  using namespace bitboards;
+
+  const color_t us = _active_color;
+  const color_t them = opposite(us);
+  const bitboard_t own = color_bb(us);
+  const bitboard_t enemy = color_bb(them);
+  const bitboard_t occupied = own | enemy;
+  const bool captures = type != gen_t::QUIETS;
+  const bool quiets = type != gen_t::CAPTURES;
+
+  bitboard_t targets = ~own;
+  if (type == gen_t::CAPTURES) { targets = enemy; }
+  if (type == gen_t::QUIETS) { targets = ~occupied; }
+
+  /*****************************************************************************
+   * Pawns
+   *
+   * All the pawns of a side move at once with shifts. Pushes to the last rank
+   * are promotions and go with the captures.
+   ****************************************************************************/
+  const bool white = us == color_t::WHITE;
+  const bitboard_t pawns = pieces_bb(us, PAWN);
+  const bitboard_t last_rank = white ? RANK_8_BB : RANK_1_BB;
+  const int up = white ? 8 : -8;
+
+  auto shift = [](const bitboard_t b, const int delta) {
+    return delta > 0 ? b << delta : b >> -delta;
+  };
+
+  const bitboard_t single = shift(pawns, up) & ~occupied;
+
+  if (captures) {
+    push_pawn_moves(list, single & last_rank, up, MOVE_QUIET, last_rank);
+    push_pawn_moves(list, shift(pawns & ~FILE_A_BB, up - 1) & enemy, up - 1,
+                    MOVE_CAPTURE, last_rank);
+    push_pawn_moves(list, shift(pawns & ~FILE_H_BB, up + 1) & enemy, up + 1,
+                    MOVE_CAPTURE, last_rank);
+  }
+
+  if (quiets) {
+    const bitboard_t double_rank = white ? RANK_3_BB : RANK_6_BB;
+    const bitboard_t doubles = shift(single & double_rank, up) & ~occupied;
+    push_pawn_moves(list, single & ~last_rank, up, MOVE_QUIET, 0);
+    push_pawn_moves(list, doubles, 2 * up, MOVE_DOUBLE_PUSH, 0);
+  }
+
+  // Only if the pawn that made the double push is there to be taken
+  if (captures && _en_passant_square != NO_SQUARE &&
+      (pieces_bb(them, PAWN) & square_bb(to_sq64(_en_passant_square) - up))) {
+    const uint8_t ep = to_sq64(_en_passant_square);
+    bitboard_t from = pawn_attacks_from(them, ep) & pawns;
+    while (from) {
+      push_move(list, pop_lsb(from), ep, MOVE_CAPTURE | MOVE_EN_PASSANT);
+    }
+  }
+
+  /*****************************************************************************
+   * Pieces
+   ****************************************************************************/
+  bitboard_t b = pieces_bb(us, KNIGHT);
+  while (b) {
+    const uint8_t from = pop_lsb(b);
+    push_targets(list, from, knight_attacks[from] & targets, enemy);
+  }
+
+  b = pieces_bb(us, BISHOP) | pieces_bb(us, QUEEN);
+  while (b) {
+    const uint8_t from = pop_lsb(b);
+    push_targets(list, from, bishop_attacks(from, occupied) & targets, enemy);
+  }
+
+  b = pieces_bb(us, ROOK) | pieces_bb(us, QUEEN);
+  while (b) {
+    const uint8_t from = pop_lsb(b);
+    push_targets(list, from, rook_attacks(from, occupied) & targets, enemy);
+  }
+
+  const uint8_t king_sq = to_sq64(king_square(us));
+  push_targets(list, king_sq, king_attacks[king_sq] & targets, enemy);
+
+  /*****************************************************************************
+   * Castling
+   *
+   * The king and the rook must be on their initial squares, the squares
+   * between them empty and the king can't start, cross or land on an
+   * attacked square.
+   ****************************************************************************/
+  if (!quiets) { return; }
+
+  const uint8_t base = us == color_t::WHITE ? 0x00 : RANK_8;
+  const uint8_t king_side = us == color_t::WHITE ? WK : BK;
+  const uint8_t queen_side = us == color_t::WHITE ? WQ : BQ;
+  const uint8_t king = make_piece(us, KING);
+  const uint8_t rook = make_piece(us, ROOK);
+
+  if ((_available_castling & (king_side | queen_side)) &&
+      piece_at(base + E1) == king && !is_square_attacked(base + E1, them)) {
+    if ((_available_castling & king_side) && piece_at(base + H1) == rook &&
+        piece_at(base + F1) == EMPTY && piece_at(base + G1) == EMPTY &&
+        !is_square_attacked(base + F1, them) &&
+        !is_square_attacked(base + G1, them)) {
+      list.push_back({static_cast<uint8_t>(base + E1),
+                      static_cast<uint8_t>(base + G1), EMPTY, MOVE_CASTLING});
+    }
+
+    if ((_available_castling & queen_side) && piece_at(base + A1) == rook &&
+        piece_at(base + B1) == EMPTY && piece_at(base + C1) == EMPTY &&
+        piece_at(base + D1) == EMPTY && !is_square_attacked(base + D1, them) &&
+        !is_square_attacked(base + C1, them)) {
+      list.push_back({static_cast<uint8_t>(base + E1),
+                      static_cast<uint8_t>(base + C1), EMPTY, MOVE_CASTLING});
+    }
+  }
+}
+
+
+/**
+ * Only the king moves, the moves of pinned pieces, en passant and the moves
+ * out of check can leave the king attacked. King moves are checked against
+ * the attackers with the king taken off the board, the few others are played
+ * and taken back.
+ */
+void board_t::filter_legal(const move_list_t& pseudo_legal, move_list_t& list)
+{
+  using namespace bitboards;
+
+  const color_t us = _active_color;
+  const color_t them = opposite(us);
+  const uint8_t king_sq = to_sq64(king_square(us));
+  const bitboard_t enemy = color_bb(them);
+  const bitboard_t occupied = occupied_bb();
+  const bool check = attackers_to(king_sq, occupied) & enemy;
+
+  // Our pieces standing alone between the king and an enemy slider
+  bitboard_t pinned = 0;
+  bitboard_t snipers =
+      ((bishop_attacks(king_sq, 0) &
+        (pieces_bb(them, BISHOP) | pieces_bb(them, QUEEN))) |
+       (rook_attacks(king_sq, 0) &
+        (pieces_bb(them, ROOK) | pieces_bb(them, QUEEN))));
+  while (snipers) {
+    const bitboard_t blockers = between[pop_lsb(snipers)][king_sq] & occupied;
+    if (popcount(blockers) == 1) { pinned |= blockers & color_bb(us); }
+  }
+
+  const bitboard_t without_king = occupied ^ square_bb(king_sq);
+
+  list.clear();
+  for (const move_t& m : pseudo_legal) {
+    // Castling is already fully checked by the generator
+    if (m.flags & MOVE_CASTLING) {
+      list.push_back(m);
+      continue;
+    }
+
+    const uint8_t from = to_sq64(m.from);
+    const uint8_t to = to_sq64(m.to);
+
+    if (from == king_sq) {
+      if (!(attackers_to(to, without_king) & enemy & ~square_bb(to))) {
+        list.push_back(m);
+      }
+      continue;
+    }
+
+    if (!check && !(pinned & square_bb(from)) &&
+        !(m.flags & MOVE_EN_PASSANT)) {
+      list.push_back(m);
+      continue;
+    }
+
+    make_move(m);
+    if (!is_square_attacked(king_square(us), them)) { list.push_back(m); }
+    unmake_move();
+  }
+}
+
+
+void board_t::generate_legal_moves(move_list_t& list)
+{
+  move_list_t pseudo_legal;
+  generate_pseudo_legal_moves(pseudo_legal, gen_t::ALL);
+  filter_legal(pseudo_legal, list);
+}
+
+
+void board_t::generate_legal_captures(move_list_t& list)
+{
+  move_list_t pseudo_legal;
+  generate_pseudo_legal_moves(pseudo_legal, gen_t::CAPTURES);
+  filter_legal(pseudo_legal, list);
+}
+
+
+void board_t::generate_legal_quiets(move_list_t& list)
+{
+  move_list_t pseudo_legal;
+  generate_pseudo_legal_moves(pseudo_legal, gen_t::QUIETS);
+  filter_legal(pseudo_legal, list);
+}
+
+
+move_t board_t::unpack_move(const uint16_t packed) const
+{
+  if (packed == NO_PACKED_MOVE) { return NULL_MOVE; }
+
+  const uint8_t from = to_index88(packed & 0x3F);
+  const uint8_t to = to_index88((packed >> 6) & 0x3F);
+  const uint8_t type = piece_type(piece_at(from));
+
+  move_t m = {from, to, static_cast<uint8_t>(packed >> 12), MOVE_QUIET};
+
+  if (piece_at(to) != EMPTY) { m.flags |= MOVE_CAPTURE; }
+
+  if (type == PAWN) {
+    if (to == _en_passant_square && (to & 7) != (from & 7)) {
+      m.flags |= MOVE_CAPTURE | MOVE_EN_PASSANT;
+    } else if (to == from + 0x20 || to + 0x20 == from) {
+      m.flags |= MOVE_DOUBLE_PUSH;
+    }
+  } else if (type == KING && (to == from + 2 || to + 2 == from)) {
+    m.flags |= MOVE_CASTLING;
+  }
+
+  return m;
+}
+
+
+bool board_t::is_pseudo_legal(const move_t& m) const
+{
+  using namespace bitboards;
+
+  const color_t us = _active_color;
+  const uint8_t moving = piece_at(m.from);
+  const uint8_t target = piece_at(m.to);
+
+  if (moving == EMPTY || piece_color(moving) != us) { return false; }
+  if (target != EMPTY && piece_color(target) == us) { return false; }
+
+  // Castling is rare enough to be checked against the generator
+  if (m.flags & MOVE_CASTLING) {
+    move_list_t list;
+    generate_pseudo_legal_moves(list, gen_t::QUIETS);
+    for (const move_t& I : list) {
+      if (I == m && (I.flags & MOVE_CASTLING)) { return true; }
+    }
+    return false;
+  }
+
+  const uint8_t from = to_sq64(m.from);
+  const uint8_t to = to_sq64(m.to);
+  const bitboard_t to_bb = square_bb(to);
+  const bitboard_t occupied = occupied_bb();
+  const uint8_t type = piece_type(moving);
+
+  if (type != PAWN) {
+    if (m.is_promotion()) { return false; }
+
+    switch (type) {
+      case KNIGHT:
+        return knight_attacks[from] & to_bb;
+      case BISHOP:
+        return bishop_attacks(from, occupied) & to_bb;
+      case ROOK:
+        return rook_attacks(from, occupied) & to_bb;
+      case QUEEN:
+        return (bishop_attacks(from, occupied) | rook_attacks(from, occupied)) &
+               to_bb;
+      default:
+        return king_attacks[from] & to_bb;
+    }
+  }
+
+  // Pawns promote on the last rank and only there
+  const bitboard_t last_rank = us == color_t::WHITE ? RANK_8_BB : RANK_1_BB;
+  if (static_cast<bool>(to_bb & last_rank) != m.is_promotion()) {
+    return false;
+  }
+  if (m.is_promotion() && (m.promotion < KNIGHT || m.promotion > QUEEN)) {
+    return false;
+  }
+
+  if (m.flags & MOVE_EN_PASSANT) {
+    return _en_passant_square != NO_SQUARE && m.to == _en_passant_square &&
+           (pawn_attacks_from(us, from) & to_bb);
+  }
+
+  if (m.flags & MOVE_CAPTURE) { return pawn_attacks_from(us, from) & to_bb; }
+
+  const int up = us == color_t::WHITE ? 8 : -8;
+  if (to == from + up) { return target == EMPTY; }
+
+  const bitboard_t start_rank =
+      us == color_t::WHITE ? RANK_1_BB << 8 : RANK_8_BB >> 8;
+  return (m.flags & MOVE_DOUBLE_PUSH) && (square_bb(from) & start_rank) &&
+         to == from + 2 * up && target == EMPTY &&
+         !(occupied & square_bb(from + up));
+}
+
+
+bool board_t::is_legal(const move_t& m)
+{
+  const color_t us = _active_color;
+
+  // Castling is checked by is_pseudo_legal
+  if (m.flags & MOVE_CASTLING) { return true; }
+
+  make_move(m);
+  const bool legal = !is_square_attacked(king_square(us), opposite(us));
+  unmake_move();
+
+  return legal;
+}
+
+
+void board_t::get_valid_moves(const uint8_t file,
+                              const uint8_t rank,
+                              move_list_t& list)
+{
+  const uint8_t index = to_index(file, rank);
+
+  move_list_t all;
+  generate_legal_moves(all);
+
+  list.clear();
+  for (const move_t& m : all) {
+    if (m.from == index) { list.push_back(m); }
+  }
+}
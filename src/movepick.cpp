@@ -0,0 +1,327 @@
+#include "movepick.hpp"
+#include <algorithm>
+#include "evaluate.hpp"
+
+// The king is worth more than everything else together
+static constexpr std::array<int, 7> SEE_VALUES = {
+    0, PIECE_VALUES[PAWN], PIECE_VALUES[KNIGHT], PIECE_VALUES[BISHOP],
+    PIECE_VALUES[ROOK], PIECE_VALUES[QUEEN], 20000};
+
+
+/*******************************************************************************
+ * Static exchange evaluation
+ ******************************************************************************/
+int see(const board_t& board, const move_t& m)
+{
+  using namespace bitboards;
+
+  const uint8_t from = to_sq64(m.from);
+  const uint8_t to = to_sq64(m.to);
+  const color_t us = board.active_color();
+
+  bitboard_t occupied = board.occupied_bb() ^ square_bb(from);
+  uint8_t victim = piece_type(board.piece_at(m.to));
+
+  if (m.flags & MOVE_EN_PASSANT) {
+    victim = PAWN;
+    occupied ^= square_bb(us == color_t::WHITE ? to - 8 : to + 8);
+  }
+
+  // gain[d] is what the side capturing at depth d wins if the exchange stops
+  std::array<int, 32> gain;
+  gain[0] = SEE_VALUES[victim];
+  int on_square = SEE_VALUES[piece_type(board.piece_at(m.from))];
+
+  if (m.is_promotion()) {
+    gain[0] += SEE_VALUES[m.promotion] - SEE_VALUES[PAWN];
+    on_square = SEE_VALUES[m.promotion];
+  }
+
+  const bitboard_t diagonal = board.type_bb(BISHOP) | board.type_bb(QUEEN);
+  const bitboard_t straight = board.type_bb(ROOK) | board.type_bb(QUEEN);
+  bitboard_t attackers = board.attackers_to(to, occupied) & occupied;
+  color_t side = opposite(us);
+  int d = 0;
+
+  while (d + 1 < static_cast<int>(gain.size())) {
+    const bitboard_t own = attackers & board.color_bb(side);
+    if (!own) { break; }
+
+    uint8_t type = PAWN;
+    while (!(own & board.type_bb(type))) {
+      ++type;
+    }
+
+    // The king can't capture a defended piece
+    if (type == KING && (attackers & board.color_bb(opposite(side)))) {
+      break;
+    }
+
+    ++d;
+    gain[d] = on_square - gain[d - 1];
+    on_square = SEE_VALUES[type];
+
+    occupied ^= square_bb(lsb(own & board.type_bb(type)));
+
+    // Sliders lined up behind the piece that just left
+    if (type == PAWN || type == BISHOP || type == QUEEN) {
+      attackers |= bishop_attacks(to, occupied) & diagonal;
+    }
+    if (type == ROOK || type == QUEEN) {
+      attackers |= rook_attacks(to, occupied) & straight;
+    }
+    attackers &= occupied;
+
+    side = opposite(side);
+  }
+
+  // Each side may stop capturing when it would lose by going on
+  while (d > 0) {
+    gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    --d;
+  }
+
+  return gain[0];
+}
+
+
+/*******************************************************************************
+ * Move picker
+ ******************************************************************************/
+move_picker_t::move_picker_t(board_t& board,
+                             const move_history_t& history,
+                             const uint16_t tt_move,
+                             const std::array<move_t, 2>& killers,
+                             const move_t& counter)
+    : _board(board), _history(history), _stage(pick_stage_t::TT_MOVE)
+{
+  if (tt_move != NO_PACKED_MOVE) {
+    const move_t m = _board.unpack_move(tt_move);
+    if (_board.is_pseudo_legal(m) && _board.is_legal(m)) { _tt_move = m; }
+  }
+
+  // The TT move leads the evasions, sorted with them
+  if (_board.in_check()) {
+    _stage = pick_stage_t::GENERATE_EVASIONS;
+    return;
+  }
+
+  if (_tt_move == NULL_MOVE) { _stage = pick_stage_t::GENERATE_CAPTURES; }
+
+  for (const move_t& I : killers) {
+    _refutations[_refutation_count++] = I;
+  }
+  if (counter != killers[0] && counter != killers[1]) {
+    _refutations[_refutation_count++] = counter;
+  }
+}
+
+
+move_picker_t::move_picker_t(board_t& board, const move_history_t& history)
+    : _board(board),
+      _history(history),
+      _stage(pick_stage_t::GENERATE_CAPTURES),
+      _quiescence(true)
+{
+  if (_board.in_check()) { _stage = pick_stage_t::GENERATE_EVASIONS; }
+}
+
+
+/**
+ * True if the killer or countermove can be played here as a quiet move
+ */
+bool move_picker_t::usable(const move_t& m)
+{
+  if (m == NULL_MOVE || m == _tt_move) { return false; }
+
+  // The flags were right where the move was found, not necessarily here
+  const move_t here = _board.unpack_move(pack_move(m));
+  if (here.is_capture() || here.is_promotion()) { return false; }
+
+  return _board.is_pseudo_legal(here) && _board.is_legal(here);
+}
+
+
+/**
+ * True if the quiet move was already yielded by an earlier stage
+ */
+bool move_picker_t::already_tried(const move_t& m) const
+{
+  if (m == _tt_move) { return true; }
+
+  for (size_t i = 0; i < _refutation_index; ++i) {
+    if (m == _refutations[i]) { return true; }
+  }
+
+  return false;
+}
+
+
+void move_picker_t::score_captures()
+{
+  for (size_t i = 0; i < _moves.size(); ++i) {
+    const move_t& m = _moves[i];
+
+    // MVV-LVA, promotions by the piece they give
+    const uint8_t victim =
+        (m.flags & MOVE_EN_PASSANT) ? PAWN : piece_type(_board.piece_at(m.to));
+    const uint8_t attacker = piece_type(_board.piece_at(m.from));
+    _scores[i] = PIECE_VALUES[victim] * 10 - attacker;
+    if (m.is_promotion()) { _scores[i] += PIECE_VALUES[m.promotion] * 10; }
+  }
+}
+
+
+void move_picker_t::score_quiets()
+{
+  const color_t us = _board.active_color();
+
+  for (size_t i = 0; i < _moves.size(); ++i) {
+    _scores[i] = _history.score(us, _moves[i]);
+  }
+}
+
+
+void move_picker_t::score_evasions()
+{
+  score_captures();
+
+  // Captures first, then the quiet moves by history
+  const color_t us = _board.active_color();
+  for (size_t i = 0; i < _moves.size(); ++i) {
+    const move_t& m = _moves[i];
+
+    if (m == _tt_move) {
+      _scores[i] = 4 * MAX_HISTORY;
+    } else if (m.is_capture() || m.is_promotion()) {
+      _scores[i] += 2 * MAX_HISTORY;
+    } else {
+      _scores[i] = _history.score(us, m);
+    }
+  }
+}
+
+
+/**
+ * Bring the best scored move left in the list at the current index and
+ * return it
+ */
+const move_t& move_picker_t::pick_best()
+{
+  size_t best = _index;
+  for (size_t j = _index + 1; j < _moves.size(); ++j) {
+    if (_scores[j] > _scores[best]) { best = j; }
+  }
+
+  if (best != _index) {
+    std::swap(_moves[_index], _moves[best]);
+    std::swap(_scores[_index], _scores[best]);
+  }
+
+  return _moves[_index++];
+}
+
+
+bool move_picker_t::next(move_t& m)
+{
+  switch (_stage) {
+    case pick_stage_t::TT_MOVE:
+      _stage = pick_stage_t::GENERATE_CAPTURES;
+      m = _tt_move;
+      return true;
+
+    case pick_stage_t::GENERATE_CAPTURES:
+      _moves.clear();
+      _board.generate_legal_captures(_moves);
+      score_captures();
+      _index = 0;
+      _stage = pick_stage_t::GOOD_CAPTURES;
+      [[fallthrough]];
+
+    case pick_stage_t::GOOD_CAPTURES:
+      while (_index < _moves.size()) {
+        const move_t& c = pick_best();
+        if (c == _tt_move) { continue; }
+
+        if (see(_board, c) < 0) {
+          // The quiescence search never tries them
+          if (!_quiescence) { _bad_captures.push_back(c); }
+          continue;
+        }
+
+        m = c;
+        return true;
+      }
+
+      if (_quiescence) {
+        _stage = pick_stage_t::DONE;
+        return false;
+      }
+
+      _stage = pick_stage_t::REFUTATIONS;
+      [[fallthrough]];
+
+    case pick_stage_t::REFUTATIONS:
+      while (_refutation_index < _refutation_count) {
+        move_t& r = _refutations[_refutation_index++];
+        if (usable(r)) {
+          r = _board.unpack_move(pack_move(r));
+          m = r;
+          return true;
+        }
+
+        // Not tried here, must not be skipped among the quiets
+        r = NULL_MOVE;
+      }
+      _stage = pick_stage_t::GENERATE_QUIETS;
+      [[fallthrough]];
+
+    case pick_stage_t::GENERATE_QUIETS:
+      _moves.clear();
+      _board.generate_legal_quiets(_moves);
+      score_quiets();
+      _index = 0;
+      _stage = pick_stage_t::QUIETS;
+      [[fallthrough]];
+
+    case pick_stage_t::QUIETS:
+      while (_index < _moves.size()) {
+        const move_t& q = pick_best();
+        if (!already_tried(q)) {
+          m = q;
+          return true;
+        }
+      }
+      _stage = pick_stage_t::BAD_CAPTURES;
+      [[fallthrough]];
+
+    case pick_stage_t::BAD_CAPTURES:
+      if (_bad_index < _bad_captures.size()) {
+        m = _bad_captures[_bad_index++];
+        return true;
+      }
+      _stage = pick_stage_t::DONE;
+      return false;
+
+    case pick_stage_t::GENERATE_EVASIONS:
+      _moves.clear();
+      _board.generate_legal_moves(_moves);
+      score_evasions();
+      _index = 0;
+      _stage = pick_stage_t::EVASIONS;
+      [[fallthrough]];
+
+    case pick_stage_t::EVASIONS:
+      if (_index < _moves.size()) {
+        m = pick_best();
+        return true;
+      }
+      _stage = pick_stage_t::DONE;
+      return false;
+
+    case pick_stage_t::DONE:
+      break;
+  }
+
+  return false;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include "board.hpp"
+#include "move.hpp"
+
+static constexpr int MAX_HISTORY = 16384;
+
+
+/**
+ * Static exchange evaluation: material won by the side making the capture
+ * once every recapture on the target square has been played, least valuable
+ * attacker first. X-rays are revealed as the pieces go, pins are ignored.
+ */
+int see(const board_t& board, const move_t& m);
+
+
+/*******************************************************************************
+ * Move history
+ *
+ * What the search learnt about the quiet moves, kept across searches by each
+ * search thread:
+ *
+ *  butterfly  [color][from][to] score of the quiet moves, raised when a move
+ *             causes a beta cutoff and lowered for the ones tried before it
+ *  counters   [piece][to] of the previous move, the quiet move that refuted
+ *             it last time
+ ******************************************************************************/
+struct move_history_t
+{
+  std::array<std::array<std::array<int, 64>, 64>, 2> butterfly = {};
+  std::array<std::array<move_t, 64>, 16> counters = {};
+
+  inline int score(const color_t c, const move_t& m) const
+  {
+    return butterfly[static_cast<int>(c)][to_sq64(m.from)][to_sq64(m.to)];
+  }
+
+  /**
+   * Move the score towards +/- MAX_HISTORY, slower as it gets close so the
+   * recent results always count
+   */
+  inline void update(const color_t c, const move_t& m, const int bonus)
+  {
+    int& h = butterfly[static_cast<int>(c)][to_sq64(m.from)][to_sq64(m.to)];
+    h += bonus - h * std::abs(bonus) / MAX_HISTORY;
+  }
+
+  inline move_t& counter(const board_t& board, const move_t& previous)
+  {
+    return counters[board.piece_at(previous.to)][to_sq64(previous.to)];
+  }
+
+  inline move_t counter(const board_t& board, const move_t& previous) const
+  {
+    return counters[board.piece_at(previous.to)][to_sq64(previous.to)];
+  }
+
+  /**
+   * Forget everything, for a new game
+   */
+  inline void clear()
+  {
+    butterfly = {};
+    counters = {};
+  }
+
+  /**
+   * Old results matter less in a new search
+   */
+  inline void age()
+  {
+    for (auto& I : butterfly) {
+      for (auto& J : I) {
+        for (int& K : J) {
+          K /= 2;
+        }
+      }
+    }
+  }
+};
+
+
+/*******************************************************************************
+ * Move picker
+ *
+ * Yields the legal moves of a position one at a time, best first. The moves
+ * are produced in stages and each stage does its work only when the previous
+ * ones didn't cause a cutoff:
+ *
+ *  1. the TT move, validated against the position, nothing is generated
+ *  2. captures and promotions by MVV-LVA, the ones losing material by SEE
+ *     are put aside
+ *  3. the killers and the countermove, if legal and quiet
+ *  4. the quiet moves by butterfly history
+ *  5. the captures put aside in 2
+ *
+ * In check all the evasions are generated and sorted at once. The quiescence
+ * picker yields the captures not losing material only, or the evasions.
+ ******************************************************************************/
+enum class pick_stage_t : uint8_t
+{
+  TT_MOVE,
+  GENERATE_CAPTURES,
+  GOOD_CAPTURES,
+  REFUTATIONS,
+  GENERATE_QUIETS,
+  QUIETS,
+  BAD_CAPTURES,
+  GENERATE_EVASIONS,
+  EVASIONS,
+  DONE
+};
+
+
+class move_picker_t
+{
+private:
+  board_t& _board;
+  const move_history_t& _history;
+  pick_stage_t _stage;
+  bool _quiescence = false;
+
+  move_t _tt_move = NULL_MOVE;
+
+  // Killers and countermove
+  std::array<move_t, 3> _refutations;
+  size_t _refutation_count = 0;
+  size_t _refutation_index = 0;
+
+  move_list_t _moves;
+  std::array<int, MAX_MOVES> _scores;
+  size_t _index = 0;
+
+  move_list_t _bad_captures;
+  size_t _bad_index = 0;
+
+  bool usable(const move_t& m);
+  bool already_tried(const move_t& m) const;
+  void score_captures();
+  void score_quiets();
+  void score_evasions();
+  const move_t& pick_best();
+
+public:
+  /**
+   * Main search picker. tt_move is packed (NO_PACKED_MOVE if none), killers
+   * and counter are NULL_MOVE when unknown.
+   */
+  move_picker_t(board_t& board,
+                const move_history_t& history,
+                const uint16_t tt_move,
+                const std::array<move_t, 2>& killers,
+                const move_t& counter);
+
+  /**
+   * Quiescence search picker
+   */
+  move_picker_t(board_t& board, const move_history_t& history);
+
+  /**
+   * Next move to try, false when there is none left
+   */
+  bool next(move_t& m);
+};
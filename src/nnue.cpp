@@ -0,0 +1,498 @@
+#include "nnue.hpp"
+#include <algorithm>
+#include <cstring>
+#include "exceptions.hpp"
+#include "mapped_file.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NNUE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace nnue {
+
+/*******************************************************************************
+ * Kernels
+ *
+ * update: out = in + the added rows - the removed rows, HIDDEN values
+ * output: dot product of the clipped accumulator halves with the output
+ *         weights
+ *
+ * All the arrays are 64 byte aligned and HIDDEN is a multiple of 32, so no
+ * kernel has a tail to handle.
+ ******************************************************************************/
+using update_fn = void (*)(int16_t* out,
+                           const int16_t* in,
+                           const int16_t* const* added,
+                           const size_t added_count,
+                           const int16_t* const* removed,
+                           const size_t removed_count);
+using output_fn = int32_t (*)(const int16_t* us,
+                              const int16_t* them,
+                              const int16_t* weights);
+
+static_assert(HIDDEN % 32 == 0, "No kernel handles a partial register");
+
+
+static void update_scalar(int16_t* out,
+                          const int16_t* in,
+                          const int16_t* const* added,
+                          const size_t added_count,
+                          const int16_t* const* removed,
+                          const size_t removed_count)
+{
+  for (size_t i = 0; i < HIDDEN; ++i) {
+    int v = in[i];
+    for (size_t a = 0; a < added_count; ++a) {
+      v += added[a][i];
+    }
+    for (size_t r = 0; r < removed_count; ++r) {
+      v -= removed[r][i];
+    }
+
+    // Wraps like the SIMD kernels
+    out[i] = static_cast<int16_t>(v);
+  }
+}
+
+
+static int32_t output_scalar(const int16_t* us,
+                             const int16_t* them,
+                             const int16_t* weights)
+{
+  int32_t sum = 0;
+
+  for (size_t i = 0; i < HIDDEN; ++i) {
+    sum += std::clamp<int>(us[i], 0, QA) * weights[i];
+    sum += std::clamp<int>(them[i], 0, QA) * weights[HIDDEN + i];
+  }
+
+  return sum;
+}
+
+
+#ifdef NNUE_X86_KERNELS
+__attribute__((target("sse4.1"))) static void update_sse41(
+    int16_t* out,
+    const int16_t* in,
+    const int16_t* const* added,
+    const size_t added_count,
+    const int16_t* const* removed,
+    const size_t removed_count)
+{
+  for (size_t i = 0; i < HIDDEN; i += 8) {
+    __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i));
+    for (size_t a = 0; a < added_count; ++a) {
+      const auto* row = reinterpret_cast<const __m128i*>(added[a] + i);
+      v = _mm_add_epi16(v, _mm_load_si128(row));
+    }
+    for (size_t r = 0; r < removed_count; ++r) {
+      const auto* row = reinterpret_cast<const __m128i*>(removed[r] + i);
+      v = _mm_sub_epi16(v, _mm_load_si128(row));
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(out + i), v);
+  }
+}
+
+
+__attribute__((target("sse4.1"))) static inline int32_t hsum_sse41(
+    __m128i v)
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+  return _mm_cvtsi128_si32(v);
+}
+
+
+__attribute__((target("sse4.1"))) static int32_t output_sse41(
+    const int16_t* us,
+    const int16_t* them,
+    const int16_t* weights)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i qa = _mm_set1_epi16(QA);
+  __m128i sum = _mm_setzero_si128();
+
+  for (const int16_t* half : {us, them}) {
+    for (size_t i = 0; i < HIDDEN; i += 8) {
+      __m128i x = _mm_load_si128(reinterpret_cast<const __m128i*>(half + i));
+      x = _mm_min_epi16(_mm_max_epi16(x, zero), qa);
+      const __m128i w =
+          _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(x, w));
+    }
+    weights += HIDDEN;
+  }
+
+  return hsum_sse41(sum);
+}
+
+
+__attribute__((target("avx2"))) static void update_avx2(
+    int16_t* out,
+    const int16_t* in,
+    const int16_t* const* added,
+    const size_t added_count,
+    const int16_t* const* removed,
+    const size_t removed_count)
+{
+  for (size_t i = 0; i < HIDDEN; i += 16) {
+    __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i));
+    for (size_t a = 0; a < added_count; ++a) {
+      const auto* row = reinterpret_cast<const __m256i*>(added[a] + i);
+      v = _mm256_add_epi16(v, _mm256_load_si256(row));
+    }
+    for (size_t r = 0; r < removed_count; ++r) {
+      const auto* row = reinterpret_cast<const __m256i*>(removed[r] + i);
+      v = _mm256_sub_epi16(v, _mm256_load_si256(row));
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(out + i), v);
+  }
+}
+
+
+__attribute__((target("avx2"))) static int32_t output_avx2(
+    const int16_t* us,
+    const int16_t* them,
+    const int16_t* weights)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i qa = _mm256_set1_epi16(QA);
+  __m256i sum = _mm256_setzero_si256();
+
+  for (const int16_t* half : {us, them}) {
+    for (size_t i = 0; i < HIDDEN; i += 16) {
+      __m256i x =
+          _mm256_load_si256(reinterpret_cast<const __m256i*>(half + i));
+      x = _mm256_min_epi16(_mm256_max_epi16(x, zero), qa);
+      const __m256i w =
+          _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, w));
+    }
+    weights += HIDDEN;
+  }
+
+  __m128i v = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                            _mm256_extracti128_si256(sum, 1));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+  return _mm_cvtsi128_si32(v);
+}
+
+
+__attribute__((target("avx512f,avx512bw"))) static void update_avx512(
+    int16_t* out,
+    const int16_t* in,
+    const int16_t* const* added,
+    const size_t added_count,
+    const int16_t* const* removed,
+    const size_t removed_count)
+{
+  for (size_t i = 0; i < HIDDEN; i += 32) {
+    __m512i v = _mm512_load_si512(in + i);
+    for (size_t a = 0; a < added_count; ++a) {
+      v = _mm512_add_epi16(v, _mm512_load_si512(added[a] + i));
+    }
+    for (size_t r = 0; r < removed_count; ++r) {
+      v = _mm512_sub_epi16(v, _mm512_load_si512(removed[r] + i));
+    }
+    _mm512_store_si512(out + i, v);
+  }
+}
+
+
+__attribute__((target("avx512f,avx512bw"))) static int32_t output_avx512(
+    const int16_t* us,
+    const int16_t* them,
+    const int16_t* weights)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i qa = _mm512_set1_epi16(QA);
+  __m512i sum = _mm512_setzero_si512();
+
+  for (const int16_t* half : {us, them}) {
+    for (size_t i = 0; i < HIDDEN; i += 32) {
+      __m512i x = _mm512_load_si512(half + i);
+      x = _mm512_min_epi16(_mm512_max_epi16(x, zero), qa);
+      const __m512i w = _mm512_load_si512(weights + i);
+      sum = _mm512_add_epi32(sum, _mm512_madd_epi16(x, w));
+    }
+    weights += HIDDEN;
+  }
+
+  // Once per evaluation, through memory is as fast as any shuffle
+  alignas(64) std::array<int32_t, 16> lanes;
+  _mm512_store_si512(lanes.data(), sum);
+
+  int32_t res = 0;
+  for (const int32_t I : lanes) {
+    res += I;
+  }
+
+  return res;
+}
+#endif
+
+
+/*******************************************************************************
+ * Dispatch
+ ******************************************************************************/
+struct kernels_t
+{
+  simd_t simd;
+  update_fn update;
+  output_fn output;
+};
+
+
+static kernels_t kernels_for(const simd_t simd)
+{
+  switch (simd) {
+#ifdef NNUE_X86_KERNELS
+    case simd_t::AVX512:
+      return {simd, update_avx512, output_avx512};
+    case simd_t::AVX2:
+      return {simd, update_avx2, output_avx2};
+    case simd_t::SSE41:
+      return {simd, update_sse41, output_sse41};
+#endif
+    default:
+      return {simd_t::SCALAR, update_scalar, output_scalar};
+  }
+}
+
+
+simd_t detected_simd()
+{
+#ifdef NNUE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return simd_t::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) { return simd_t::AVX2; }
+  if (__builtin_cpu_supports("sse4.1")) { return simd_t::SSE41; }
+#endif
+  return simd_t::SCALAR;
+}
+
+
+static kernels_t kernels = kernels_for(detected_simd());
+
+
+simd_t active_simd()
+{
+  return kernels.simd;
+}
+
+
+const char* simd_name(const simd_t simd)
+{
+  switch (simd) {
+    case simd_t::AVX512:
+      return "AVX-512";
+    case simd_t::AVX2:
+      return "AVX2";
+    case simd_t::SSE41:
+      return "SSE4.1";
+    default:
+      return "scalar";
+  }
+}
+
+
+void force_simd(const simd_t simd)
+{
+  kernels = kernels_for(std::min(simd, detected_simd()));
+}
+
+
+/*******************************************************************************
+ * Network file
+ ******************************************************************************/
+std::unique_ptr<network_t> load(const std::string& path)
+{
+  mapped_file_t file(path);
+
+  auto net = std::make_unique<network_t>();
+  const size_t header_size = sizeof(MAGIC) + 2 * sizeof(uint32_t);
+  const size_t expected = header_size + sizeof(net->feature_weights) +
+                          sizeof(net->feature_biases) +
+                          sizeof(net->output_weights) + sizeof(int32_t);
+
+  uint32_t version = 0;
+  uint32_t hidden = 0;
+  if (file.size() >= header_size) {
+    std::memcpy(&version, file.data() + sizeof(MAGIC), sizeof(version));
+    std::memcpy(&hidden, file.data() + sizeof(MAGIC) + sizeof(version),
+                sizeof(hidden));
+  }
+
+  if (file.size() < header_size ||
+      std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0 ||
+      version != NNUE_VERSION) {
+    throw input_exception(path + " is not a network file");
+  }
+  if (hidden != HIDDEN || file.size() != expected) {
+    throw input_exception(path + " is not a 768x" + std::to_string(HIDDEN) +
+                          " network");
+  }
+
+  const char* data = file.data() + header_size;
+  auto read = [&data](void* dst, const size_t size) {
+    std::memcpy(dst, data, size);
+    data += size;
+  };
+
+  read(net->feature_weights.data(), sizeof(net->feature_weights));
+  read(net->feature_biases.data(), sizeof(net->feature_biases));
+  read(net->output_weights.data(), sizeof(net->output_weights));
+  read(&net->output_bias, sizeof(net->output_bias));
+
+  return net;
+}
+
+
+/*******************************************************************************
+ * Evaluator
+ ******************************************************************************/
+evaluator_t::evaluator_t()
+    : _stack(std::make_unique<std::array<accumulator_t, STACK_SIZE>>())
+{}
+
+
+void evaluator_t::reset(const network_t* network, const board_t& board)
+{
+  _network = network;
+  _top = 0;
+
+  if (_network) { refresh((*_stack)[0], board); }
+}
+
+
+void evaluator_t::refresh(accumulator_t& acc, const board_t& board) const
+{
+  for (const color_t perspective : {color_t::WHITE, color_t::BLACK}) {
+    std::array<int16_t, HIDDEN>& values =
+        acc.values[static_cast<int>(perspective)];
+    values = _network->feature_biases;
+
+    for (const color_t c : {color_t::WHITE, color_t::BLACK}) {
+      for (uint8_t slot = 0; slot < board.piece_count(c); ++slot) {
+        const uint8_t index = board.piece_square(c, slot);
+        const size_t feature =
+            feature_index(perspective, board.piece_at(index), to_sq64(index));
+        const int16_t* row = &_network->feature_weights[feature * HIDDEN];
+
+        kernels.update(values.data(), values.data(), &row, 1, nullptr, 0);
+      }
+    }
+  }
+
+  acc.computed = true;
+}
+
+
+void evaluator_t::update(const accumulator_t& from, accumulator_t& to) const
+{
+  const dirty_pieces_t& d = to.dirty;
+
+  for (const color_t perspective : {color_t::WHITE, color_t::BLACK}) {
+    std::array<const int16_t*, 2> added;
+    std::array<const int16_t*, 2> removed;
+
+    for (uint8_t i = 0; i < d.added; ++i) {
+      const size_t feature =
+          feature_index(perspective, d.added_piece[i], d.added_square[i]);
+      added[i] = &_network->feature_weights[feature * HIDDEN];
+    }
+    for (uint8_t i = 0; i < d.removed; ++i) {
+      const size_t feature =
+          feature_index(perspective, d.removed_piece[i], d.removed_square[i]);
+      removed[i] = &_network->feature_weights[feature * HIDDEN];
+    }
+
+    const int side = static_cast<int>(perspective);
+    kernels.update(to.values[side].data(), from.values[side].data(),
+                   added.data(), d.added, removed.data(), d.removed);
+  }
+
+  to.computed = true;
+}
+
+
+void evaluator_t::push(const board_t& board, const move_t& m)
+{
+  assert(_top + 1 < STACK_SIZE);
+
+  accumulator_t& next = (*_stack)[++_top];
+  dirty_pieces_t& d = next.dirty;
+  next.computed = false;
+  d.added = 0;
+  d.removed = 0;
+
+  auto add = [&d](const uint8_t p, const uint8_t index) {
+    d.added_piece[d.added] = p;
+    d.added_square[d.added++] = to_sq64(index);
+  };
+  auto remove = [&d](const uint8_t p, const uint8_t index) {
+    d.removed_piece[d.removed] = p;
+    d.removed_square[d.removed++] = to_sq64(index);
+  };
+
+  const uint8_t moving = board.piece_at(m.from);
+  const color_t us = piece_color(moving);
+
+  remove(moving, m.from);
+  add(m.is_promotion() ? make_piece(us, m.promotion) : moving, m.to);
+
+  if (m.flags & MOVE_EN_PASSANT) {
+    const uint8_t captured = us == color_t::WHITE ? m.to - 0x10 : m.to + 0x10;
+    remove(board.piece_at(captured), captured);
+  } else if (m.flags & MOVE_CAPTURE) {
+    remove(board.piece_at(m.to), m.to);
+  } else if (m.flags & MOVE_CASTLING) {
+    const uint8_t base = m.from & 0x70;
+    const bool king_side = (m.to & 7) == 6;
+    const uint8_t rook = make_piece(us, ROOK);
+    remove(rook, king_side ? base + 7 : base + 0);
+    add(rook, king_side ? base + 5 : base + 3);
+  }
+}
+
+
+void evaluator_t::push_null()
+{
+  assert(_top + 1 < STACK_SIZE);
+
+  accumulator_t& next = (*_stack)[++_top];
+  next.computed = false;
+  next.dirty.added = 0;
+  next.dirty.removed = 0;
+}
+
+
+int evaluator_t::evaluate(const board_t& board)
+{
+  std::array<accumulator_t, STACK_SIZE>& stack = *_stack;
+
+  // The root is always computed
+  size_t computed = _top;
+  while (!stack[computed].computed) {
+    --computed;
+  }
+  for (size_t i = computed + 1; i <= _top; ++i) {
+    update(stack[i - 1], stack[i]);
+  }
+
+  const accumulator_t& acc = stack[_top];
+  const int us = static_cast<int>(board.active_color());
+
+  const int32_t output =
+      kernels.output(acc.values[us].data(), acc.values[us ^ 1].data(),
+                     _network->output_weights.data());
+
+  const int64_t value = static_cast<int64_t>(output) + _network->output_bias;
+  return static_cast<int>(value * SCALE / (QA * QB));
+}
+
+}  // namespace nnue
@@ -0,0 +1,171 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "board.hpp"
+#include "move.hpp"
+
+
+/*******************************************************************************
+ * NNUE evaluation
+ *
+ * (768 -> HIDDEN) x 2 -> 1 network. The inputs are the 12 piece kinds on the
+ * 64 squares, seen once from each side: for black the colors are swapped and
+ * the board mirrored vertically, so both halves share the same weights. The
+ * first layer output (the accumulator) only changes by a few weight rows per
+ * move and is updated incrementally. The output layer takes the side to move
+ * half first, clipped to [0, QA] (CReLU).
+ *
+ * The int16 kernels exist for AVX-512, AVX2, SSE4.1 and plain C++, the best
+ * one the CPU supports is chosen at startup.
+ *
+ * File format, little endian:
+ *
+ *   char[8]   magic "CHESSONN"
+ *   uint32    version, NNUE_VERSION
+ *   uint32    hidden size, must be HIDDEN
+ *   int16     feature weights [768][HIDDEN], feature (see feature_index)
+ *             major
+ *   int16     feature biases [HIDDEN]
+ *   int16     output weights [2 * HIDDEN], side to move half first
+ *   int32     output bias
+ *
+ * The evaluation in centipawns is (output + bias) * SCALE / (QA * QB).
+ ******************************************************************************/
+namespace nnue {
+
+static constexpr char MAGIC[8] = {'C', 'H', 'E', 'S', 'S', 'O', 'N', 'N'};
+static constexpr uint32_t NNUE_VERSION = 1;
+
+static constexpr size_t INPUTS = 768;
+static constexpr size_t HIDDEN = 256;
+static constexpr int QA = 255;
+static constexpr int QB = 64;
+static constexpr int SCALE = 400;
+
+// Enough for the deepest search line
+static constexpr size_t STACK_SIZE = 256;
+
+
+enum class simd_t : uint8_t
+{
+  SCALAR,
+  SSE41,
+  AVX2,
+  AVX512
+};
+
+
+/**
+ * Best kernels supported by this CPU
+ */
+simd_t detected_simd();
+
+/**
+ * Kernels in use, the detected ones unless forced lower
+ */
+simd_t active_simd();
+const char* simd_name(const simd_t simd);
+
+/**
+ * Use the kernels of a lower instruction set, for benchmarks. Clamped to
+ * the detected one. Not thread safe: no evaluation can be running.
+ */
+void force_simd(const simd_t simd);
+
+
+struct network_t
+{
+  alignas(64) std::array<int16_t, INPUTS * HIDDEN> feature_weights;
+  alignas(64) std::array<int16_t, HIDDEN> feature_biases;
+  alignas(64) std::array<int16_t, 2 * HIDDEN> output_weights;
+  int32_t output_bias;
+};
+
+
+/**
+ * Load a network file. Throws input_exception if it can't be read or is not
+ * a network of this architecture.
+ */
+std::unique_ptr<network_t> load(const std::string& path);
+
+
+/**
+ * Input of a piece on a sq64 square seen from the perspective side
+ */
+inline size_t feature_index(const color_t perspective,
+                            const uint8_t p,
+                            const uint8_t sq)
+{
+  const bool own = piece_color(p) == perspective;
+  const size_t kind = (own ? 0 : 6) + piece_type(p) - 1;
+  const uint8_t square = perspective == color_t::WHITE ? sq : sq ^ 56;
+
+  return kind * 64 + square;
+}
+
+
+/**
+ * Pieces entering and leaving the board with one move, at most two each way
+ * (castling, captures with promotion)
+ */
+struct dirty_pieces_t
+{
+  uint8_t added = 0;
+  uint8_t removed = 0;
+  std::array<uint8_t, 2> added_piece;
+  std::array<uint8_t, 2> added_square;
+  std::array<uint8_t, 2> removed_piece;
+  std::array<uint8_t, 2> removed_square;
+};
+
+
+struct accumulator_t
+{
+  alignas(64) std::array<std::array<int16_t, HIDDEN>, 2> values;
+  dirty_pieces_t dirty;
+  bool computed = false;
+};
+
+
+/**
+ * Accumulators of the current search line, one per ply. push() is called
+ * before the board plays a move and only records what the move changes, the
+ * accumulator itself is brought up to date by evaluate() when needed, from
+ * the closest computed one. Nodes cut before their evaluation never pay for
+ * it. Nothing is allocated after construction.
+ */
+class evaluator_t
+{
+private:
+  const network_t* _network = nullptr;
+  std::unique_ptr<std::array<accumulator_t, STACK_SIZE>> _stack;
+  size_t _top = 0;
+
+  void refresh(accumulator_t& acc, const board_t& board) const;
+  void update(const accumulator_t& from, accumulator_t& to) const;
+
+public:
+  evaluator_t();
+
+  inline bool enabled() const { return _network != nullptr; }
+
+  /**
+   * Start a new line from this position. A null network disables the
+   * evaluator.
+   */
+  void reset(const network_t* network, const board_t& board);
+
+  void push(const board_t& board, const move_t& m);
+  void push_null();
+  inline void pop() { --_top; }
+
+  /**
+   * Evaluation in centipawns from the point of view of the side to move
+   */
+  int evaluate(const board_t& board);
+};
+
+}  // namespace nnue
@@ -0,0 +1,213 @@
+#include "packed.hpp"
+#include <algorithm>
+#include <cstring>
+#include "exceptions.hpp"
+
+
+/*******************************************************************************
+ * Position
+ ******************************************************************************/
+void board_t::pack(packed_position_t& packed) const
+{
+  packed = {};
+  packed.occupancy = occupied_bb();
+
+  bitboard_t b = packed.occupancy;
+  for (unsigned i = 0; b; ++i) {
+    const uint8_t code = piece_at(to_index88(pop_lsb(b)));
+    packed.pieces[i >> 1] |= code << ((i & 1) * 4);
+  }
+
+  packed.flags =
+      (_active_color == color_t::WHITE) | (_available_castling << 1);
+  packed.en_passant = _en_passant_square == NO_SQUARE
+                          ? NO_PACKED_SQUARE
+                          : to_sq64(_en_passant_square);
+  packed.halfmove_clock =
+      static_cast<uint8_t>(std::min(_halfmove_clock, 255));
+  packed.full_move = static_cast<uint16_t>(std::min(_full_move, 65535));
+}
+
+
+fen_error_t board_t::unpack(const packed_position_t& packed) noexcept
+{
+  cleanup();
+  _history.clear();
+
+  const int pieces = popcount(packed.occupancy);
+  if (pieces > static_cast<int>(2 * MAX_PIECES_PER_SIDE)) {
+    return fen_error_t::TOO_MANY_PIECES;
+  }
+
+  bitboard_t b = packed.occupancy;
+  for (unsigned i = 0; b; ++i) {
+    const uint8_t sq = pop_lsb(b);
+    const uint8_t code = (packed.pieces[i >> 1] >> ((i & 1) * 4)) & 0x0F;
+    const uint8_t type = piece_type(code);
+
+    if (type == EMPTY || type > KING) { return fen_error_t::INVALID_PIECE; }
+    if (type == PAWN && (square_bb(sq) & (RANK_1_BB | RANK_8_BB))) {
+      return fen_error_t::PAWN_ON_LAST_RANK;
+    }
+
+    const fen_error_t e = add_piece(to_index88(sq), code);
+    if (e != fen_error_t::OK) { return e; }
+  }
+
+  for (int side = 0; side < 2; ++side) {
+    if (_piece_count[side] == 0 ||
+        piece_type(_board[_piece_list[side][0]]) != KING) {
+      return fen_error_t::MISSING_KING;
+    }
+  }
+
+  _active_color = (packed.flags & 1) ? color_t::WHITE : color_t::BLACK;
+  _available_castling = (packed.flags >> 1) & (WQ | WK | BQ | BK);
+
+  if (packed.en_passant == NO_PACKED_SQUARE) {
+    _en_passant_square = NO_SQUARE;
+  } else if (packed.en_passant < 64) {
+    _en_passant_square = to_index88(packed.en_passant);
+  } else {
+    return fen_error_t::INVALID_EN_PASSANT;
+  }
+
+  if (!en_passant_valid()) { return fen_error_t::INVALID_EN_PASSANT; }
+  if (opponent_in_check()) { return fen_error_t::OPPONENT_IN_CHECK; }
+
+  if (packed.full_move < 1) { return fen_error_t::INVALID_FULLMOVE_NUMBER; }
+
+  _halfmove_clock = packed.halfmove_clock;
+  _full_move = packed.full_move;
+  _key = compute_key();
+
+  return fen_error_t::OK;
+}
+
+
+/*******************************************************************************
+ * Writer
+ ******************************************************************************/
+packed_writer_t::packed_writer_t(const std::string& path,
+                                 const bool with_index)
+    : _with_index(with_index)
+{
+  _file = std::fopen(path.c_str(), "wb");
+  if (_file == nullptr) { throw input_exception("Can't open " + path); }
+
+  // Room for the header, written for real by close()
+  const packed_header_t header = {};
+  std::fwrite(&header, sizeof(header), 1, _file);
+}
+
+
+packed_writer_t::~packed_writer_t()
+{
+  // Nothing to do with an error here, close() reports them when called
+  try {
+    close();
+  } catch (const input_exception&) {
+  }
+}
+
+
+void packed_writer_t::append(const board_t& board)
+{
+  packed_position_t packed;
+  board.pack(packed);
+
+  if (std::fwrite(&packed, sizeof(packed), 1, _file) != 1) {
+    throw input_exception("Write error");
+  }
+
+  if (_with_index) { _index.push_back({board.key(), _count}); }
+  ++_count;
+}
+
+
+void packed_writer_t::close()
+{
+  if (_file == nullptr) { return; }
+
+  packed_header_t header = {};
+  std::memcpy(header.magic, PACKED_MAGIC, sizeof(header.magic));
+  header.version = PACKED_VERSION;
+  header.record_size = sizeof(packed_position_t);
+  header.count = _count;
+
+  bool ok = true;
+
+  if (_with_index) {
+    std::sort(_index.begin(), _index.end(),
+              [](const packed_index_entry_t& a, const packed_index_entry_t& b) {
+                return a.key < b.key;
+              });
+
+    header.index_offset =
+        sizeof(packed_header_t) + _count * sizeof(packed_position_t);
+    ok = std::fwrite(_index.data(), sizeof(packed_index_entry_t),
+                     _index.size(), _file) == _index.size();
+  }
+
+  ok = ok && std::fseek(_file, 0, SEEK_SET) == 0 &&
+       std::fwrite(&header, sizeof(header), 1, _file) == 1;
+  ok = std::fclose(_file) == 0 && ok;
+  _file = nullptr;
+
+  if (!ok) { throw input_exception("Write error"); }
+}
+
+
+/*******************************************************************************
+ * Reader
+ ******************************************************************************/
+packed_reader_t::packed_reader_t(const std::string& path) : _file(path)
+{
+  const size_t size = _file.size();
+
+  if (size < sizeof(packed_header_t)) {
+    throw input_exception(path + " is not a packed positions file");
+  }
+
+  _header = reinterpret_cast<const packed_header_t*>(_file.data());
+  if (std::memcmp(_header->magic, PACKED_MAGIC, sizeof(PACKED_MAGIC)) != 0 ||
+      _header->version != PACKED_VERSION ||
+      _header->record_size != sizeof(packed_position_t)) {
+    throw input_exception(path + " is not a packed positions file");
+  }
+
+  const uint64_t records_end =
+      sizeof(packed_header_t) + _header->count * sizeof(packed_position_t);
+  if (records_end > size) { throw input_exception(path + " is truncated"); }
+
+  _records = reinterpret_cast<const packed_position_t*>(
+      _file.data() + sizeof(packed_header_t));
+
+  if (_header->index_offset) {
+    const uint64_t index_end =
+        _header->index_offset + _header->count * sizeof(packed_index_entry_t);
+    if (_header->index_offset < records_end || index_end > size) {
+      throw input_exception(path + " has a bad index");
+    }
+
+    _index = reinterpret_cast<const packed_index_entry_t*>(
+        _file.data() + _header->index_offset);
+  }
+
+  _file.advise_random();
+}
+
+
+uint64_t packed_reader_t::find(const uint64_t key) const
+{
+  if (_index == nullptr) { return NOT_FOUND; }
+
+  const packed_index_entry_t* end = _index + _header->count;
+  const packed_index_entry_t* it =
+      std::lower_bound(_index, end, key,
+                       [](const packed_index_entry_t& e, const uint64_t k) {
+                         return e.key < k;
+                       });
+
+  return it != end && it->key == key ? it->record : NOT_FOUND;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "mapped_file.hpp"
+
+
+/*******************************************************************************
+ * Packed positions
+ *
+ * A position in 32 bytes, about a third of its FEN:
+ *
+ *  0 -  7   occupancy, bit sq64 set for every piece
+ *  8 - 23   4 bit piece codes (as in piece.hpp) of the occupied squares from
+ *           A1 to H8, low nibble first
+ * 24        bit 0 white to move, bits 1 - 4 castling rights (WQ WK BQ BK)
+ * 25        en passant square as sq64, NO_PACKED_SQUARE if none
+ * 26        halfmove clock, saturated at 255
+ * 27        reserved, 0
+ * 28 - 29   fullmove number, saturated at 65535
+ * 30 - 31   reserved, 0
+ *
+ * Multi byte fields are stored little endian, files written on little endian
+ * machines only.
+ ******************************************************************************/
+static constexpr uint8_t NO_PACKED_SQUARE = 0xFF;
+
+
+struct packed_position_t
+{
+  uint64_t occupancy;
+  std::array<uint8_t, 16> pieces;
+  uint8_t flags;
+  uint8_t en_passant;
+  uint8_t halfmove_clock;
+  uint8_t reserved;
+  uint16_t full_move;
+  uint16_t reserved2;
+};
+
+static_assert(sizeof(packed_position_t) == 32, "Packed positions are 32 bytes");
+
+
+/*******************************************************************************
+ * Container
+ *
+ * header | records | index
+ *
+ * The records are fixed size so the position i is at a known offset. The
+ * optional index maps the Zobrist keys to record numbers, sorted by key, to
+ * find a position without scanning.
+ ******************************************************************************/
+static constexpr char PACKED_MAGIC[8] = {'C', 'H', 'E', 'S',
+                                         'S', 'O', 'P', 'K'};
+static constexpr uint32_t PACKED_VERSION = 1;
+
+
+struct packed_header_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t count;
+  uint64_t index_offset;  // 0 without index
+};
+
+static_assert(sizeof(packed_header_t) == 32, "The header is 32 bytes");
+
+
+struct packed_index_entry_t
+{
+  uint64_t key;
+  uint64_t record;
+};
+
+
+/**
+ * Append only writer. The header and the index are written by close(), also
+ * called by the destructor. Throws input_exception on I/O errors.
+ */
+class packed_writer_t
+{
+private:
+  std::FILE* _file = nullptr;
+  uint64_t _count = 0;
+  bool _with_index;
+  std::vector<packed_index_entry_t> _index;
+
+public:
+  explicit packed_writer_t(const std::string& path,
+                           const bool with_index = true);
+  ~packed_writer_t();
+
+  packed_writer_t(const packed_writer_t&) = delete;
+  packed_writer_t& operator=(const packed_writer_t&) = delete;
+
+  void append(const board_t& board);
+  void close();
+
+  inline uint64_t size() const { return _count; }
+};
+
+
+/**
+ * Memory mapped reader, the records are used in place. Throws
+ * input_exception if the file is not a valid container.
+ */
+class packed_reader_t
+{
+private:
+  mapped_file_t _file;
+  const packed_header_t* _header = nullptr;
+  const packed_position_t* _records = nullptr;
+  const packed_index_entry_t* _index = nullptr;
+
+public:
+  static constexpr uint64_t NOT_FOUND = ~0ULL;
+
+  explicit packed_reader_t(const std::string& path);
+
+  inline uint64_t size() const { return _header->count; }
+  inline bool has_index() const { return _index != nullptr; }
+
+  inline const packed_position_t& operator[](const uint64_t i) const
+  {
+    return _records[i];
+  }
+
+  /**
+   * Record number of a position with this key, NOT_FOUND if there is none
+   * or the file has no index
+   */
+  uint64_t find(const uint64_t key) const;
+};
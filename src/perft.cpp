@@ -0,0 +1,47 @@
+#include "perft.hpp"
+#include "log.hpp"
+
+
+uint64_t perft(board_t& board, const int depth)
+{
+  move_list_t moves;
+  board.generate_legal_moves(moves);
+
+  // Bulk counting: no need to play the moves of the last ply
+  if (depth <= 1) { return depth == 1 ? moves.size() : 1; }
+
+  uint64_t nodes = 0;
+  for (const move_t& m : moves) {
+    board.make_move(m);
+    nodes += perft(board, depth - 1);
+    board.unmake_move();
+  }
+
+  return nodes;
+}
+
+
+uint64_t perft_divide(
+    board_t& board,
+    const int depth,
+    const std::function<void(const move_t&, uint64_t)>& on_move)
+{
+  move_list_t moves;
+  board.generate_legal_moves(moves);
+
+  uint64_t nodes = 0;
+  for (const move_t& m : moves) {
+    board.make_move(m);
+    const uint64_t n = perft(board, depth - 1);
+    board.unmake_move();
+    nodes += n;
+
+    if (on_move) {
+      on_move(m, n);
+    } else {
+      LOG_I << to_string(m) << ": " << n << END_I;
+    }
+  }
+
+  return nodes;
+}
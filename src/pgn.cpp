@@ -0,0 +1,200 @@
+#include "pgn.hpp"
+#include <algorithm>
+
+
+static inline bool is_space(const char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+
+std::string_view pgn_game_t::tag(const std::string_view name) const
+{
+  for (size_t i = 0; i < tag_count; ++i) {
+    if (tags[i].name == name) { return tags[i].value; }
+  }
+
+  return {};
+}
+
+
+bool pgn_reader_t::next(pgn_game_t& game)
+{
+  const size_t size = _text.size();
+
+  game.tag_count = 0;
+  game.movetext = {};
+
+  auto skip_spaces = [&]() {
+    while (_pos < size && is_space(_text[_pos])) {
+      ++_pos;
+    }
+  };
+
+  auto skip_line = [&]() {
+    while (_pos < size && _text[_pos] != '\n') {
+      ++_pos;
+    }
+  };
+
+  /*****************************************************************************
+   * Tag pairs: [Name "value"]
+   ****************************************************************************/
+  for (;;) {
+    skip_spaces();
+    if (_pos >= size) { return false; }
+
+    // Escaped lines
+    if (_text[_pos] == '%') {
+      skip_line();
+      continue;
+    }
+
+    if (_text[_pos] != '[') { break; }
+    ++_pos;
+
+    const size_t name = _pos;
+    while (_pos < size && !is_space(_text[_pos]) && _text[_pos] != ']') {
+      ++_pos;
+    }
+    const std::string_view tag_name = _text.substr(name, _pos - name);
+
+    while (_pos < size && _text[_pos] != '"' && _text[_pos] != ']') {
+      ++_pos;
+    }
+
+    std::string_view tag_value;
+    if (_pos < size && _text[_pos] == '"') {
+      const size_t value = ++_pos;
+      while (_pos < size && _text[_pos] != '"') {
+        _pos += _text[_pos] == '\\' ? 2 : 1;
+      }
+      _pos = std::min(_pos, size);
+      tag_value = _text.substr(value, _pos - value);
+    }
+
+    // Whatever is left up to the end of the line
+    skip_line();
+
+    if (game.tag_count < MAX_PGN_TAGS) {
+      game.tags[game.tag_count++] = {tag_name, tag_value};
+    }
+  }
+
+  /*****************************************************************************
+   * Movetext, up to the next tag at the start of a line
+   ****************************************************************************/
+  const size_t begin = _pos;
+  size_t end = _pos;
+
+  while (_pos < size) {
+    const char c = _text[_pos];
+
+    if (c == '{') {
+      while (_pos < size && _text[_pos] != '}') {
+        ++_pos;
+      }
+    } else if (c == ';') {
+      skip_line();
+      continue;
+    } else if (c == '\n' && _pos + 1 < size && _text[_pos + 1] == '[') {
+      ++_pos;
+      break;
+    }
+
+    ++_pos;
+    end = _pos;
+  }
+
+  game.movetext = _text.substr(begin, std::min(end, size) - begin);
+
+  return game.tag_count > 0 || !game.movetext.empty();
+}
+
+
+bool pgn_moves_t::next(std::string_view& san)
+{
+  const size_t size = _text.size();
+
+  while (_pos < size) {
+    const char c = _text[_pos];
+
+    if (is_space(c) || c == '.' || c == ')') {
+      ++_pos;
+      continue;
+    }
+
+    // Comments
+    if (c == '{') {
+      while (_pos < size && _text[_pos] != '}') {
+        ++_pos;
+      }
+      ++_pos;
+      continue;
+    }
+
+    if (c == ';' || c == '%') {
+      while (_pos < size && _text[_pos] != '\n') {
+        ++_pos;
+      }
+      continue;
+    }
+
+    // Variations, possibly nested and with comments inside
+    if (c == '(') {
+      int level = 0;
+      while (_pos < size) {
+        const char v = _text[_pos++];
+        if (v == '{') {
+          while (_pos < size && _text[_pos] != '}') {
+            ++_pos;
+          }
+          ++_pos;
+        } else if (v == '(') {
+          ++level;
+        } else if (v == ')' && --level == 0) {
+          break;
+        }
+      }
+      continue;
+    }
+
+    // Numeric annotation glyphs
+    if (c == '$') {
+      ++_pos;
+      while (_pos < size && _text[_pos] >= '0' && _text[_pos] <= '9') {
+        ++_pos;
+      }
+      continue;
+    }
+
+    const size_t begin = _pos;
+    while (_pos < size && !is_space(_text[_pos]) && _text[_pos] != '{' &&
+           _text[_pos] != '(' && _text[_pos] != ')' && _text[_pos] != ';') {
+      ++_pos;
+    }
+    std::string_view token = _text.substr(begin, _pos - begin);
+
+    // Game termination
+    if (token == "*" || token == "1-0" || token == "0-1" ||
+        token == "1/2-1/2") {
+      _pos = size;
+      return false;
+    }
+
+    // Move numbers, possibly glued to the move (12.e4, 12...Nf6)
+    if (token.front() >= '1' && token.front() <= '9') {
+      while (!token.empty() &&
+             ((token.front() >= '0' && token.front() <= '9') ||
+              token.front() == '.')) {
+        token.remove_prefix(1);
+      }
+      if (token.empty()) { continue; }
+    }
+
+    san = token;
+    return true;
+  }
+
+  return false;
+}
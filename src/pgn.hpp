@@ -0,0 +1,137 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include "board.hpp"
+#include "san.hpp"
+
+
+/*******************************************************************************
+ * Streaming PGN reader
+ *
+ * Everything works on views of the input text (usually a mapped_file_t), no
+ * game, tag or move is ever copied. Tag values are returned as written, with
+ * the escapes still in.
+ ******************************************************************************/
+static constexpr size_t MAX_PGN_TAGS = 32;
+
+
+struct pgn_tag_t
+{
+  std::string_view name;
+  std::string_view value;
+};
+
+
+struct pgn_game_t
+{
+  std::array<pgn_tag_t, MAX_PGN_TAGS> tags;
+  size_t tag_count = 0;
+  std::string_view movetext;
+
+  /**
+   * Value of the tag or an empty view
+   */
+  std::string_view tag(const std::string_view name) const;
+};
+
+
+/**
+ * Cuts the input in games, one at a time
+ */
+class pgn_reader_t
+{
+private:
+  std::string_view _text;
+  size_t _pos = 0;
+
+public:
+  explicit pgn_reader_t(const std::string_view text) : _text(text) {}
+
+  /**
+   * Read the next game, false when the input is over
+   */
+  bool next(pgn_game_t& game);
+
+  /**
+   * Bytes consumed so far
+   */
+  inline size_t position() const { return _pos; }
+};
+
+
+/**
+ * The SAN moves of the main line. Comments, variations, NAGs, move numbers
+ * and the result are skipped.
+ */
+class pgn_moves_t
+{
+private:
+  std::string_view _text;
+  size_t _pos = 0;
+
+public:
+  explicit pgn_moves_t(const std::string_view movetext) : _text(movetext) {}
+
+  bool next(std::string_view& san);
+};
+
+
+enum class pgn_error_t
+{
+  OK,
+  INVALID_FEN,
+  ILLEGAL_MOVE
+};
+
+
+struct pgn_replay_result_t
+{
+  pgn_error_t error = pgn_error_t::OK;
+  int plies = 0;
+  std::string_view move;  // The move that failed
+
+  inline explicit operator bool() const { return error == pgn_error_t::OK; }
+};
+
+
+/**
+ * Play the main line of the game on the board, from the FEN tag if there is
+ * one. After every move on_move(board, move, san) is called with the new
+ * position, returning false stops the replay.
+ */
+template <typename F>
+pgn_replay_result_t pgn_replay(board_t& board,
+                               const pgn_game_t& game,
+                               F&& on_move)
+{
+  pgn_replay_result_t res;
+
+  const std::string_view fen = game.tag("FEN");
+  if (!board.parse(fen.empty() ? std::string_view(FEN_INIT_POS) : fen)) {
+    res.error = pgn_error_t::INVALID_FEN;
+    return res;
+  }
+
+  pgn_moves_t moves(game.movetext);
+  std::string_view san;
+  move_t m;
+
+  while (moves.next(san)) {
+    if (!parse_san(board, san, m)) {
+      res.error = pgn_error_t::ILLEGAL_MOVE;
+      res.move = san;
+      return res;
+    }
+
+    board.make_move(m);
+    ++res.plies;
+
+    // Nothing before an irreversible move can repeat
+    board.trim_history();
+
+    if (!on_move(static_cast<const board_t&>(board), m, san)) { break; }
+  }
+
+  return res;
+}
@@ -1,55 +1,119 @@
 #pragma once
 #include <array>
 #include <cstdint>
-#include <vector>
 
-static const std::array<uint8_t, 2> offsets_p = {0x10, 0x20};
 
+enum class color_t
+{
+  BLACK,
+  WHITE
+};
+
+
+inline color_t opposite(const color_t c)
+{
+  return c == color_t::WHITE ? color_t::BLACK : color_t::WHITE;
+}
+
+
+// clang-format off
+/**
+ * Piece encoding
+ *
+ * One nibble per piece. The low 3 bits are the piece type and bit 3 is set
+ * for the black pieces. 0 is the empty square.
+ *
+ *   P = 0x1   N = 0x2   B = 0x3   R = 0x4   Q = 0x5   K = 0x6
+ *   p = 0x9   n = 0xA   b = 0xB   r = 0xC   q = 0xD   k = 0xE
+ */
+// clang-format on
+static constexpr uint8_t EMPTY = 0x00;
+static constexpr uint8_t PAWN = 0x01;
+static constexpr uint8_t KNIGHT = 0x02;
+static constexpr uint8_t BISHOP = 0x03;
+static constexpr uint8_t ROOK = 0x04;
+static constexpr uint8_t QUEEN = 0x05;
+static constexpr uint8_t KING = 0x06;
+static constexpr uint8_t BLACK_PIECE = 0x08;
+static constexpr uint8_t PIECE_TYPE_MASK = 0x07;
+static constexpr uint8_t PIECE_MASK = 0x0F;
+
+
+inline constexpr uint8_t make_piece(const color_t color, const uint8_t type)
+{
+  return color == color_t::BLACK ? (type | BLACK_PIECE) : type;
+}
+
+inline constexpr uint8_t piece_type(const uint8_t p)
+{
+  return p & PIECE_TYPE_MASK;
+}
 
+inline constexpr color_t piece_color(const uint8_t p)
+{
+  return (p & BLACK_PIECE) ? color_t::BLACK : color_t::WHITE;
+}
+
+inline constexpr char piece_to_char(const uint8_t p)
+{
+  constexpr char chars[] = ".PNBRQK..pnbrqk.";
+  return chars[p & PIECE_MASK];
+}
+
+inline constexpr uint8_t char_to_piece(const char c)
+{
+  switch (c) {
+    case 'P':
+      return PAWN;
+    case 'N':
+      return KNIGHT;
+    case 'B':
+      return BISHOP;
+    case 'R':
+      return ROOK;
+    case 'Q':
+      return QUEEN;
+    case 'K':
+      return KING;
+    case 'p':
+      return PAWN | BLACK_PIECE;
+    case 'n':
+      return KNIGHT | BLACK_PIECE;
+    case 'b':
+      return BISHOP | BLACK_PIECE;
+    case 'r':
+      return ROOK | BLACK_PIECE;
+    case 'q':
+      return QUEEN | BLACK_PIECE;
+    case 'k':
+      return KING | BLACK_PIECE;
+    default:
+      return EMPTY;
+  }
+}
+
+
+/**
+ * Lightweight read only view of a piece on the board. It is a plain value
+ * built on demand by the board, it doesn't own anything.
+ */
 class piece_t
 {
 private:
-  char _p = 0;
+  uint8_t _p = EMPTY;
   uint8_t _index = 0;
-  uint8_t _file = 0;
-  uint8_t _rank = 0;
 
 public:
-  piece_t(const uint8_t file, const uint8_t rank, const char c)
-      : _file(file), _rank(rank), _p(c), _index((rank << 4) + file)
-  {}
+  piece_t() = default;
+  piece_t(const uint8_t index, const uint8_t p) : _p(p), _index(index) {}
 
-  inline uint8_t file() const { return _file; }
-  inline uint8_t rank() const { return _rank; }
+  inline uint8_t file() const { return _index & 7; }
+  inline uint8_t rank() const { return _index >> 4; }
   inline uint8_t index() const { return _index; }
-  inline char c() const { return _p; }
-
-  inline void set_file(const uint8_t f) { _file = f; }
-  inline void set_rank(const uint8_t r) { _rank = r; }
-  inline void set_index(const uint8_t i) { _index = i; }
-
-  inline std::vector<uint8_t> get_all_moves()
-  {
-    std::vector<uint8_t> result;
-
-    switch (_p) {
-      case 'p':
-        result.reserve(offsets_p.size());
-        for (const auto I : offsets_p) {
-          result.push_back(_index - I);
-        }
-        break;
-
-      case 'P':
-        result.reserve(offsets_p.size());
-        for (const auto I : offsets_p) {
-          result.push_back(_index + I);
-        }
-        break;
-
-      default:
-        break;
-    }
-    return result;
-  }
-};
\ No newline at end of file
+  inline uint8_t code() const { return _p; }
+  inline uint8_t type() const { return piece_type(_p); }
+  inline color_t color() const { return piece_color(_p); }
+  inline char c() const { return piece_to_char(_p); }
+
+  inline explicit operator bool() const { return _p != EMPTY; }
+};
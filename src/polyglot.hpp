@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "mapped_file.hpp"
+#include "move.hpp"
+
+
+/*******************************************************************************
+ * Polyglot opening books
+ *
+ * A .bin book is a sorted array of 16 bytes big endian entries:
+ *
+ *   uint64    key of the position, Polyglot hashing (see key())
+ *   uint16    move: to file, to rank, from file, from rank on 3 bits each,
+ *             then the promotion (0 none, 1 knight ... 4 queen). Castling is
+ *             the king taking its own rook, e1h1 for instance.
+ *   uint16    weight, the higher the better
+ *   uint32    learn, unused
+ *
+ * The file is memory mapped and the entries of a position are found with a
+ * binary search, there is no loading step.
+ ******************************************************************************/
+namespace polyglot {
+
+static constexpr size_t ENTRY_SIZE = 16;
+
+
+struct book_move_t
+{
+  move_t move;
+  uint16_t weight;
+};
+
+
+/**
+ * Polyglot hash of the position. It doesn't use the random numbers of
+ * board_t::key(), the books are made with their own.
+ */
+uint64_t key(const board_t& board);
+
+
+class book_t
+{
+private:
+  mapped_file_t _file;
+  std::string _path;
+  size_t _count = 0;
+  std::minstd_rand _rng{std::random_device{}()};
+
+public:
+  book_t() = default;
+
+  book_t(const book_t&) = delete;
+  book_t& operator=(const book_t&) = delete;
+
+  /**
+   * Map the book. Throws input_exception if the file can't be opened or is
+   * not a whole number of entries.
+   */
+  void open(const std::string& path);
+  void close();
+
+  inline bool is_open() const { return _count > 0; }
+  inline const std::string& path() const { return _path; }
+
+  // Number of entries
+  inline size_t size() const { return _count; }
+
+  /**
+   * The legal book moves of the position, the heaviest first. Entries for
+   * moves that are not legal here (a key collision) are skipped.
+   */
+  void moves(board_t& board, std::vector<book_move_t>& res) const;
+
+  /**
+   * A book move for the position, false if out of book. Either the heaviest
+   * one, or one at random with a probability proportional to its weight.
+   */
+  bool probe(board_t& board, move_t& m, const bool best = false);
+};
+
+}  // namespace polyglot
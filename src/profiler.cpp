@@ -0,0 +1,147 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include "exceptions.hpp"
+
+namespace profile {
+
+static constexpr std::array<const char*, SECTIONS> SECTION_NAMES = {
+    "frame",       "input",       "board layer", "analysis",
+    "coordinates", "right panel", "board"};
+
+
+const char* section_name(const section_t section)
+{
+  return section < SECTIONS ? SECTION_NAMES[section] : "?";
+}
+
+
+/**
+ * Small id of the calling thread, in order of first use
+ */
+static uint32_t thread_id()
+{
+  static std::atomic<uint32_t> next{0};
+  thread_local const uint32_t id = next.fetch_add(1);
+  return id;
+}
+
+
+uint64_t now_ns()
+{
+  static const auto epoch = std::chrono::steady_clock::now();
+
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - epoch)
+          .count());
+}
+
+
+void ring_t::record(const section_t section,
+                    const uint64_t start_ns,
+                    const uint64_t duration_ns)
+{
+  const uint64_t index = _head.fetch_add(1, std::memory_order_relaxed);
+  slot_t& slot = _slots[index & (RING_CAPACITY - 1)];
+
+  // 0 while the slot is rewritten, so a reader can tell
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.start_ns.store(start_ns, std::memory_order_relaxed);
+  slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+  slot.tag.store(section | (static_cast<uint64_t>(thread_id()) << 8),
+                 std::memory_order_relaxed);
+
+  slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+
+void ring_t::collect(std::vector<sample_t>& res) const
+{
+  res.clear();
+
+  const uint64_t head = _head.load(std::memory_order_acquire);
+  const uint64_t first = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+  res.reserve(head - first);
+
+  for (uint64_t i = first; i < head; ++i) {
+    const slot_t& slot = _slots[i & (RING_CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != i + 1) { continue; }
+
+    sample_t s;
+    s.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+    s.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+    const uint64_t tag = slot.tag.load(std::memory_order_relaxed);
+    s.section = static_cast<section_t>(tag & 0xFF);
+    s.thread = static_cast<uint32_t>(tag >> 8);
+
+    // Overwritten while we were reading it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != i + 1) { continue; }
+
+    res.push_back(s);
+  }
+}
+
+
+ring_t& ring()
+{
+  static ring_t instance;
+  return instance;
+}
+
+
+std::array<section_stats_t, SECTIONS> compute_stats(
+    const std::vector<sample_t>& samples)
+{
+  std::array<std::vector<uint64_t>, SECTIONS> durations;
+  for (const sample_t& I : samples) {
+    if (I.section < SECTIONS) { durations[I.section].push_back(I.duration_ns); }
+  }
+
+  std::array<section_stats_t, SECTIONS> res;
+  for (size_t i = 0; i < SECTIONS; ++i) {
+    std::vector<uint64_t>& d = durations[i];
+    if (d.empty()) { continue; }
+
+    auto percentile = [&d](const size_t p) {
+      const size_t k = std::min(d.size() - 1, d.size() * p / 100);
+      std::nth_element(d.begin(), d.begin() + k, d.end());
+      return static_cast<double>(d[k]) / 1e6;
+    };
+
+    res[i].count = d.size();
+    res[i].p50_ms = percentile(50);
+    res[i].p99_ms = percentile(99);
+  }
+
+  return res;
+}
+
+
+void write_chrome_trace(const std::string& path)
+{
+  std::vector<sample_t> samples;
+  ring().collect(samples);
+
+  std::ofstream out(path);
+  if (!out) { throw input_exception("Can't write " + path); }
+
+  // Timestamps and durations in microseconds
+  out << "{\"traceEvents\":[";
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const sample_t& s = samples[i];
+    out << (i ? ",\n" : "\n") << "{\"name\":\"" << section_name(s.section)
+        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << s.thread
+        << ",\"ts\":" << s.start_ns / 1000.0
+        << ",\"dur\":" << s.duration_ns / 1000.0 << "}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  if (!out) { throw input_exception("Can't write " + path); }
+}
+
+}  // namespace profile
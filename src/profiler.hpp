@@ -0,0 +1,151 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Built with the profiler unless told otherwise, see CHESSO_PROFILE in CMake
+#if !defined(CHESSO_PROFILE)
+#define CHESSO_PROFILE 1
+#endif
+
+
+/*******************************************************************************
+ * Scoped timers
+ *
+ * PROFILE_SCOPE(section) times the rest of the enclosing scope and pushes a
+ * sample to a lock-free ring buffer. Any thread can record, the oldest
+ * samples are overwritten. The overlay computes percentiles from the ring
+ * and write_chrome_trace() dumps it for chrome://tracing or Perfetto.
+ *
+ * With CHESSO_PROFILE=0 the macro expands to nothing.
+ ******************************************************************************/
+namespace profile {
+
+static constexpr bool ENABLED = CHESSO_PROFILE;
+
+// At 60 FPS and a handful of sections per frame, about half a minute
+static constexpr size_t RING_CAPACITY = 1 << 14;
+
+
+enum section_t : uint8_t
+{
+  FRAME,
+  INPUT,
+  BOARD_LAYER,
+  ANALYSIS,
+  DRAW_COORDINATES,
+  RIGHT_PANEL,
+  DRAW_BOARD,
+  SECTIONS
+};
+
+
+const char* section_name(const section_t section);
+
+
+struct sample_t
+{
+  section_t section;
+  uint32_t thread;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+};
+
+
+struct section_stats_t
+{
+  size_t count = 0;
+  double p50_ms = 0.0;
+  double p99_ms = 0.0;
+};
+
+
+/**
+ * Multi producer ring of samples. A writer claims a slot with one atomic
+ * increment and publishes it with a sequence number, the reader skips the
+ * slots being rewritten while it copies them. Nobody ever waits.
+ */
+class ring_t
+{
+private:
+  struct slot_t
+  {
+    std::atomic<uint64_t> sequence{0};  // Index + 1 once written
+    std::atomic<uint64_t> start_ns{0};
+    std::atomic<uint64_t> duration_ns{0};
+    std::atomic<uint64_t> tag{0};  // Section and thread
+  };
+
+  std::array<slot_t, RING_CAPACITY> _slots;
+  alignas(64) std::atomic<uint64_t> _head{0};
+
+public:
+  void record(const section_t section,
+              const uint64_t start_ns,
+              const uint64_t duration_ns);
+
+  /**
+   * The samples still in the ring, oldest first
+   */
+  void collect(std::vector<sample_t>& res) const;
+};
+
+
+/**
+ * The ring every timer writes to
+ */
+ring_t& ring();
+
+
+/**
+ * Nanoseconds since the first call, steady clock
+ */
+uint64_t now_ns();
+
+
+/**
+ * Median and 99th percentile of every section
+ */
+std::array<section_stats_t, SECTIONS> compute_stats(
+    const std::vector<sample_t>& samples);
+
+
+/**
+ * Chrome trace event format, one complete event per sample. Throws
+ * input_exception if the file can't be written.
+ */
+void write_chrome_trace(const std::string& path);
+
+
+class scoped_timer_t
+{
+private:
+  const section_t _section;
+  const uint64_t _start_ns;
+
+public:
+  explicit scoped_timer_t(const section_t section)
+      : _section(section), _start_ns(now_ns())
+  {}
+
+  ~scoped_timer_t() { ring().record(_section, _start_ns, now_ns() - _start_ns); }
+
+  scoped_timer_t(const scoped_timer_t&) = delete;
+  scoped_timer_t& operator=(const scoped_timer_t&) = delete;
+};
+
+}  // namespace profile
+
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#if CHESSO_PROFILE
+#define PROFILE_SCOPE(section) \
+  const profile::scoped_timer_t PROFILE_CONCAT(_profile_timer_, __LINE__)(section)
+#else
+#define PROFILE_SCOPE(section) ((void)0)
+#endif
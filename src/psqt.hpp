@@ -0,0 +1,222 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "piece.hpp"
+
+
+/**
+ * Midgame and endgame halves of an evaluation term, blended by the game
+ * phase at the end of the evaluation
+ */
+struct score_t
+{
+  int mg = 0;
+  int eg = 0;
+
+  constexpr score_t& operator+=(const score_t& o)
+  {
+    mg += o.mg;
+    eg += o.eg;
+    return *this;
+  }
+
+  constexpr score_t& operator-=(const score_t& o)
+  {
+    mg -= o.mg;
+    eg -= o.eg;
+    return *this;
+  }
+
+  constexpr score_t operator+(const score_t& o) const
+  {
+    return {mg + o.mg, eg + o.eg};
+  }
+  constexpr score_t operator-(const score_t& o) const
+  {
+    return {mg - o.mg, eg - o.eg};
+  }
+  constexpr score_t operator*(const int k) const { return {mg * k, eg * k}; }
+
+  constexpr bool operator==(const score_t& o) const
+  {
+    return mg == o.mg && eg == o.eg;
+  }
+};
+
+
+/*******************************************************************************
+ * Piece-square tables
+ *
+ * Material plus placement of every piece on every square, from the point of
+ * view of white: the black pieces count negative. The board keeps the sum of
+ * the entries of its pieces up to date in make_move and unmake_move, so the
+ * evaluation never scans the pieces for them.
+ *
+ * The source tables below are for white and read like a board, rank 8 on top.
+ ******************************************************************************/
+namespace psqt {
+
+// Game phase: 24 with all the pieces on the board, 0 with pawns and kings
+static constexpr std::array<int, 7> PHASE_WEIGHTS = {0, 0, 1, 1, 2, 4, 0};
+static constexpr int MAX_PHASE = 24;
+
+static constexpr std::array<score_t, 7> MATERIAL = {
+    score_t{0, 0},     score_t{82, 94},   score_t{337, 281},
+    score_t{365, 297}, score_t{477, 512}, score_t{1025, 936},
+    score_t{0, 0}};
+
+using table_t = std::array<int, 64>;
+
+// clang-format off
+static constexpr table_t PAWN_MG = {
+   0,   0,   0,   0,   0,   0,   0,   0,
+  40,  40,  40,  40,  40,  40,  40,  40,
+  10,  10,  20,  30,  30,  20,  10,  10,
+   5,   5,  10,  25,  25,  10,   5,   5,
+   0,   0,   0,  20,  20,   0,   0,   0,
+   5,  -5, -10,   0,   0, -10,  -5,   5,
+   5,  10,  10, -20, -20,  10,  10,   5,
+   0,   0,   0,   0,   0,   0,   0,   0};
+
+static constexpr table_t PAWN_EG = {
+   0,   0,   0,   0,   0,   0,   0,   0,
+  60,  60,  55,  50,  50,  55,  60,  60,
+  35,  35,  30,  25,  25,  30,  35,  35,
+  15,  15,  10,   5,   5,  10,  15,  15,
+   5,   5,   0,   0,   0,   0,   5,   5,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0};
+
+static constexpr table_t KNIGHT_MG = {
+ -50, -40, -30, -30, -30, -30, -40, -50,
+ -40, -20,   0,   0,   0,   0, -20, -40,
+ -30,   0,  10,  15,  15,  10,   0, -30,
+ -30,   5,  15,  20,  20,  15,   5, -30,
+ -30,   0,  15,  20,  20,  15,   0, -30,
+ -30,   5,  10,  15,  15,  10,   5, -30,
+ -40, -20,   0,   5,   5,   0, -20, -40,
+ -50, -40, -30, -30, -30, -30, -40, -50};
+
+static constexpr table_t BISHOP_MG = {
+ -20, -10, -10, -10, -10, -10, -10, -20,
+ -10,   0,   0,   0,   0,   0,   0, -10,
+ -10,   0,   5,  10,  10,   5,   0, -10,
+ -10,   5,   5,  10,  10,   5,   5, -10,
+ -10,   0,  10,  10,  10,  10,   0, -10,
+ -10,  10,  10,  10,  10,  10,  10, -10,
+ -10,   5,   0,   0,   0,   0,   5, -10,
+ -20, -10, -10, -10, -10, -10, -10, -20};
+
+static constexpr table_t ROOK_MG = {
+   0,   0,   0,   0,   0,   0,   0,   0,
+   5,  10,  10,  10,  10,  10,  10,   5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+   0,   0,   0,   5,   5,   0,   0,   0};
+
+static constexpr table_t QUEEN_MG = {
+ -20, -10, -10,  -5,  -5, -10, -10, -20,
+ -10,   0,   0,   0,   0,   0,   0, -10,
+ -10,   0,   5,   5,   5,   5,   0, -10,
+  -5,   0,   5,   5,   5,   5,   0,  -5,
+   0,   0,   5,   5,   5,   5,   0,  -5,
+ -10,   5,   5,   5,   5,   5,   0, -10,
+ -10,   0,   5,   0,   0,   0,   0, -10,
+ -20, -10, -10,  -5,  -5, -10, -10, -20};
+
+// Knights, bishops and queens just want the center in the endgame
+static constexpr table_t CENTER_EG = {
+ -30, -20, -15, -10, -10, -15, -20, -30,
+ -20, -10,  -5,   0,   0,  -5, -10, -20,
+ -15,  -5,   5,  10,  10,   5,  -5, -15,
+ -10,   0,  10,  15,  15,  10,   0, -10,
+ -10,   0,  10,  15,  15,  10,   0, -10,
+ -15,  -5,   5,  10,  10,   5,  -5, -15,
+ -20, -10,  -5,   0,   0,  -5, -10, -20,
+ -30, -20, -15, -10, -10, -15, -20, -30};
+
+static constexpr table_t ROOK_EG = {
+   5,   5,   5,   5,   5,   5,   5,   5,
+  10,  10,  10,  10,  10,  10,  10,  10,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0};
+
+static constexpr table_t KING_MG = {
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -20, -30, -30, -40, -40, -30, -30, -20,
+ -10, -20, -20, -20, -20, -20, -20, -10,
+  20,  20,   0,   0,   0,   0,  20,  20,
+  20,  30,  10,   0,   0,  10,  30,  20};
+
+static constexpr table_t KING_EG = {
+ -50, -40, -30, -20, -20, -30, -40, -50,
+ -30, -20, -10,   0,   0, -10, -20, -30,
+ -30, -10,  20,  30,  30,  20, -10, -30,
+ -30, -10,  30,  40,  40,  30, -10, -30,
+ -30, -10,  30,  40,  40,  30, -10, -30,
+ -30, -10,  20,  30,  30,  20, -10, -30,
+ -30, -30,   0,   0,   0,   0, -30, -30,
+ -50, -30, -30, -30, -30, -30, -30, -50};
+// clang-format on
+
+
+static constexpr std::array<const table_t*, 7> MG_TABLES = {
+    nullptr, &PAWN_MG, &KNIGHT_MG, &BISHOP_MG, &ROOK_MG, &QUEEN_MG, &KING_MG};
+static constexpr std::array<const table_t*, 7> EG_TABLES = {
+    nullptr, &PAWN_EG, &CENTER_EG, &CENTER_EG, &ROOK_EG, &CENTER_EG, &KING_EG};
+
+
+/**
+ * Indexed by piece code and sq64. One piece is 512 bytes, the whole table
+ * 8 KB starting on a cache line.
+ */
+struct alignas(64) entries_t
+{
+  std::array<std::array<score_t, 64>, 16> scores = {};
+};
+
+
+constexpr entries_t generate()
+{
+  entries_t res;
+
+  for (uint8_t type = PAWN; type <= KING; ++type) {
+    for (uint8_t sq = 0; sq < 64; ++sq) {
+      // The source tables have rank 8 first
+      const uint8_t white = sq ^ 56;
+      const uint8_t black = sq;
+
+      const score_t w = MATERIAL[type] + score_t{(*MG_TABLES[type])[white],
+                                                 (*EG_TABLES[type])[white]};
+      const score_t b = MATERIAL[type] + score_t{(*MG_TABLES[type])[black],
+                                                 (*EG_TABLES[type])[black]};
+
+      res.scores[make_piece(color_t::WHITE, type)][sq] = w;
+      res.scores[make_piece(color_t::BLACK, type)][sq] = score_t{} - b;
+    }
+  }
+
+  return res;
+}
+
+
+inline constexpr entries_t TABLE = generate();
+
+
+inline constexpr const score_t& of(const uint8_t p, const uint8_t sq)
+{
+  return TABLE.scores[p][sq];
+}
+
+}  // namespace psqt
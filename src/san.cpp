@@ -0,0 +1,118 @@
+#include "san.hpp"
+
+
+static inline bool is_file(const char c)
+{
+  return c >= 'a' && c <= 'h';
+}
+
+
+static inline bool is_rank(const char c)
+{
+  return c >= '1' && c <= '8';
+}
+
+
+static inline uint8_t san_piece_type(const char c)
+{
+  switch (c) {
+    case 'N':
+      return KNIGHT;
+    case 'B':
+      return BISHOP;
+    case 'R':
+      return ROOK;
+    case 'Q':
+      return QUEEN;
+    case 'K':
+      return KING;
+    default:
+      return EMPTY;
+  }
+}
+
+
+bool parse_san(board_t& board, std::string_view san, move_t& move)
+{
+  // Check marks and annotations
+  while (!san.empty() && (san.back() == '+' || san.back() == '#' ||
+                          san.back() == '!' || san.back() == '?')) {
+    san.remove_suffix(1);
+  }
+
+  if (san.size() < 2) { return false; }
+
+  move_list_t list;
+  board.generate_legal_moves(list);
+
+  /*****************************************************************************
+   * Castling
+   ****************************************************************************/
+  if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+    const uint8_t file = san.size() == 3 ? 6 : 2;
+
+    for (const move_t& m : list) {
+      if ((m.flags & MOVE_CASTLING) && (m.to & 7) == file) {
+        move = m;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /*****************************************************************************
+   * [piece][from file][from rank][x]<to>[=promotion]
+   ****************************************************************************/
+  uint8_t type = san_piece_type(san.front());
+  if (type == EMPTY) {
+    type = PAWN;
+  } else {
+    san.remove_prefix(1);
+  }
+
+  uint8_t promotion = EMPTY;
+  if (type == PAWN && san.size() >= 3) {
+    const uint8_t p = san_piece_type(san.back());
+    if (p != EMPTY && p != KING) {
+      promotion = p;
+      san.remove_suffix(1);
+      if (san.back() == '=') { san.remove_suffix(1); }
+    }
+  }
+
+  if (san.size() < 2) { return false; }
+
+  const char to_file = san[san.size() - 2];
+  const char to_rank = san[san.size() - 1];
+  if (!is_file(to_file) || !is_rank(to_rank)) { return false; }
+
+  const uint8_t to = board_t::to_index(to_file - 'a', to_rank - '1');
+  san.remove_suffix(2);
+
+  // What is left is the disambiguation and the capture mark
+  int from_file = -1;
+  int from_rank = -1;
+  for (const char c : san) {
+    if (is_file(c)) {
+      from_file = c - 'a';
+    } else if (is_rank(c)) {
+      from_rank = c - '1';
+    } else if (c != 'x' && c != ':' && c != '-') {
+      return false;
+    }
+  }
+
+  int found = 0;
+  for (const move_t& m : list) {
+    if (m.to != to || m.promotion != promotion) { continue; }
+    if (piece_type(board.piece_at(m.from)) != type) { continue; }
+    if (from_file >= 0 && (m.from & 7) != from_file) { continue; }
+    if (from_rank >= 0 && (m.from >> 4) != from_rank) { continue; }
+
+    move = m;
+    ++found;
+  }
+
+  return found == 1;
+}
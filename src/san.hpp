@@ -0,0 +1,14 @@
+#pragma once
+#include <string_view>
+#include "board.hpp"
+#include "move.hpp"
+
+
+/**
+ * Resolve a move in Standard Algebraic Notation (e4, Nbd7, exd8=Q+, O-O)
+ * against the legal moves of the board. Check marks and annotations (+ # ! ?)
+ * are ignored, 0-0 is accepted for O-O and the promotion can be written with
+ * or without the =. Returns false if the move is not legal or ambiguous.
+ * Allocates nothing.
+ */
+bool parse_san(board_t& board, std::string_view san, move_t& move);
@@ -0,0 +1,883 @@
+#include "search.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "evaluate.hpp"
+#include "movepick.hpp"
+#include "nnue.hpp"
+#include "syzygy.hpp"
+
+static constexpr int64_t MOVE_OVERHEAD_MS = 30;
+static constexpr int ASPIRATION_DEPTH = 5;
+static constexpr int ASPIRATION_WINDOW = 25;
+static constexpr uint64_t CHECK_LIMITS_EVERY = 1024;
+
+static_assert(MAX_PLY < nnue::STACK_SIZE, "The NNUE stack holds a full line");
+static_assert(MAX_PLY <= STATS_DEPTHS, "Every iteration can be timed");
+
+
+/**
+ * Late move reductions indexed by depth and move number
+ */
+static const std::array<std::array<int, 64>, 64> lmr_table = [] {
+  std::array<std::array<int, 64>, 64> table = {};
+  for (int depth = 1; depth < 64; ++depth) {
+    for (int move = 1; move < 64; ++move) {
+      table[depth][move] = static_cast<int>(
+          0.75 + std::log(depth) * std::log(move) / 2.25);
+    }
+  }
+  return table;
+}();
+
+
+// Mates and tablebase wins are stored relative to the node, not the root
+static inline int score_to_tt(const int score, const int ply)
+{
+  if (score >= VALUE_TB_WIN_IN_MAX_PLY) { return score + ply; }
+  if (score <= -VALUE_TB_WIN_IN_MAX_PLY) { return score - ply; }
+  return score;
+}
+
+
+static inline int score_from_tt(const int score, const int ply)
+{
+  if (score >= VALUE_TB_WIN_IN_MAX_PLY) { return score - ply; }
+  if (score <= -VALUE_TB_WIN_IN_MAX_PLY) { return score + ply; }
+  return score;
+}
+
+
+static inline int64_t now_ms()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+
+static inline int64_t now_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+
+/*******************************************************************************
+ * Worker
+ ******************************************************************************/
+class search_thread_t
+{
+private:
+  search_t& _owner;
+  const size_t _id;
+
+  std::thread _thread;
+  board_t _board;
+  std::array<pv_t, MAX_PLY + 1> _pv;
+  int _seldepth = 0;
+
+  pawn_table_t _pawns;
+  nnue::evaluator_t _nnue;
+
+  // Move ordering
+  move_history_t _history;
+  std::array<std::array<move_t, 2>, MAX_PLY + 1> _killers;
+
+  // Only this thread writes it, the control thread sums them
+  struct alignas(64) counter_t
+  {
+    std::atomic<uint64_t> nodes{0};
+    std::atomic<uint64_t> tb_hits{0};
+  } _counter;
+
+  search_counters_t _stats;
+
+  inline bool is_main() const { return _id == 0; }
+  inline bool stopped() const
+  {
+    return _owner._stop.load(std::memory_order_relaxed);
+  }
+
+  inline void count_node()
+  {
+    const uint64_t n = _counter.nodes.load(std::memory_order_relaxed) + 1;
+    _counter.nodes.store(n, std::memory_order_relaxed);
+
+    if (is_main() && (n % CHECK_LIMITS_EVERY) == 0) { _owner.check_limits(); }
+  }
+
+  /**
+   * The board and the NNUE accumulators move together
+   */
+  inline void make_move(const move_t& m)
+  {
+    if (_nnue.enabled()) { _nnue.push(_board, m); }
+    _board.make_move(m);
+  }
+
+  inline void unmake_move()
+  {
+    _board.unmake_move();
+    if (_nnue.enabled()) { _nnue.pop(); }
+  }
+
+  inline void make_null_move()
+  {
+    if (_nnue.enabled()) { _nnue.push_null(); }
+    _board.make_null_move();
+  }
+
+  inline void unmake_null_move()
+  {
+    _board.unmake_null_move();
+    if (_nnue.enabled()) { _nnue.pop(); }
+  }
+
+  /**
+   * The network if one is loaded, the handcrafted evaluation otherwise.
+   * Never in the mate range.
+   */
+  inline int static_evaluation()
+  {
+    if (!_nnue.enabled()) { return evaluate(_board, _pawns); }
+
+    return std::clamp(_nnue.evaluate(_board), -VALUE_MATE_IN_MAX_PLY + 1,
+                      VALUE_MATE_IN_MAX_PLY - 1);
+  }
+
+  void update_pv(const int ply, const move_t& m);
+  void update_quiet_stats(const move_t& best,
+                          const move_list_t& failed,
+                          const int depth,
+                          const int ply);
+
+  bool probe_tablebases(const int depth, syzygy::wdl_t& wdl);
+  int search(int alpha, int beta, int depth, const int ply, const bool null);
+  int qsearch(int alpha, int beta, const int ply);
+
+public:
+  // Result of the last completed iteration
+  pv_t best_pv;
+  int best_score = 0;
+  int completed_depth = 0;
+
+  search_thread_t(search_t& owner, const size_t id) : _owner(owner), _id(id)
+  {}
+
+  inline uint64_t nodes() const
+  {
+    return _counter.nodes.load(std::memory_order_relaxed);
+  }
+
+  inline uint64_t tb_hits() const
+  {
+    return _counter.tb_hits.load(std::memory_order_relaxed);
+  }
+
+  inline const search_counters_t& stats() const { return _stats; }
+
+  void prepare(const board_t& board);
+  void clear();
+  void iterative_deepening();
+
+  inline move_t first_legal_move()
+  {
+    move_list_t moves;
+    _board.generate_legal_moves(moves);
+
+    for (const move_t& I : moves) {
+      if (_owner.is_root_move(I)) { return I; }
+    }
+
+    return NULL_MOVE;
+  }
+
+  inline void start()
+  {
+    _thread = std::thread(&search_thread_t::iterative_deepening, this);
+  }
+
+  inline void join()
+  {
+    if (_thread.joinable()) { _thread.join(); }
+  }
+};
+
+
+void search_thread_t::prepare(const board_t& board)
+{
+  _board = board;
+  _nnue.reset(_owner._network, board);
+  _counter.nodes.store(0, std::memory_order_relaxed);
+  _counter.tb_hits.store(0, std::memory_order_relaxed);
+  _stats.clear();
+  _seldepth = 0;
+  best_pv.length = 0;
+  best_score = 0;
+  completed_depth = 0;
+
+  // The killers are for this search, the history is kept but ages
+  for (auto& I : _killers) {
+    I = {NULL_MOVE, NULL_MOVE};
+  }
+  _history.age();
+}
+
+
+void search_thread_t::clear()
+{
+  _history.clear();
+  for (auto& I : _killers) {
+    I = {NULL_MOVE, NULL_MOVE};
+  }
+}
+
+
+void search_thread_t::update_pv(const int ply, const move_t& m)
+{
+  pv_t& pv = _pv[ply];
+  const pv_t& child = _pv[ply + 1];
+
+  pv.moves[0] = m;
+  std::copy(child.moves.begin(), child.moves.begin() + child.length,
+            pv.moves.begin() + 1);
+  pv.length = child.length + 1;
+}
+
+
+/**
+ * A quiet move caused a beta cutoff: make it a killer and the countermove of
+ * the previous move, and move the history of the quiet moves tried before it
+ * down
+ */
+void search_thread_t::update_quiet_stats(const move_t& best,
+                                         const move_list_t& failed,
+                                         const int depth,
+                                         const int ply)
+{
+  std::array<move_t, 2>& killers = _killers[ply];
+  if (killers[0] != best) {
+    killers[1] = killers[0];
+    killers[0] = best;
+  }
+
+  const move_t previous = _board.last_move();
+  if (previous != NULL_MOVE) { _history.counter(_board, previous) = best; }
+
+  const color_t us = _board.active_color();
+  const int bonus = std::min(32 * depth * depth, MAX_HISTORY / 8);
+
+  _history.update(us, best, bonus);
+  for (const move_t& I : failed) {
+    _history.update(us, I, -bonus);
+  }
+}
+
+
+/**
+ * WDL of the position if it is worth probing: the fifty moves counter was
+ * just reset, so the stored result holds, and there are few enough pieces
+ */
+bool search_thread_t::probe_tablebases(const int depth, syzygy::wdl_t& wdl)
+{
+  syzygy::tablebases_t* tablebases = _owner._tablebases;
+  if (!tablebases || _board.halfmove_clock() != 0) { return false; }
+
+  const int limit = _owner._tb_probe_limit > 0
+                        ? std::min(_owner._tb_probe_limit,
+                                   tablebases->max_pieces())
+                        : tablebases->max_pieces();
+  const int pieces = popcount(_board.occupied_bb());
+
+  // At the limit only deep enough, the tables with the most pieces are the
+  // slowest to read
+  if (pieces > limit || (pieces == limit && depth < _owner._tb_probe_depth)) {
+    return false;
+  }
+
+  if (!tablebases->probe_wdl(_board, wdl)) { return false; }
+
+  const uint64_t n = _counter.tb_hits.load(std::memory_order_relaxed) + 1;
+  _counter.tb_hits.store(n, std::memory_order_relaxed);
+  return true;
+}
+
+
+int search_thread_t::qsearch(int alpha, int beta, const int ply)
+{
+  _pv[ply].length = 0;
+  count_node();
+  _stats.add(STAT_QNODES);
+
+  if (stopped()) { return 0; }
+
+  _seldepth = std::max(_seldepth, ply);
+
+  if (_board.is_draw()) { return VALUE_DRAW; }
+  if (ply >= MAX_PLY - 1) { return static_evaluation(); }
+
+  const bool in_check = _board.in_check();
+  int best_score = -VALUE_MATE + ply;
+
+  // Stand pat: we are not forced to capture
+  if (!in_check) {
+    best_score = static_evaluation();
+    if (best_score >= beta) { return best_score; }
+    alpha = std::max(alpha, best_score);
+  }
+
+  move_picker_t picker(_board, _history);
+  move_t m;
+
+  while (picker.next(m)) {
+    make_move(m);
+    const int score = -qsearch(-beta, -alpha, ply + 1);
+    unmake_move();
+
+    if (stopped()) { return 0; }
+
+    if (score > best_score) {
+      best_score = score;
+      if (score > alpha) {
+        alpha = score;
+        update_pv(ply, m);
+        if (alpha >= beta) { break; }
+      }
+    }
+  }
+
+  return best_score;
+}
+
+
+int search_thread_t::search(int alpha,
+                            int beta,
+                            int depth,
+                            const int ply,
+                            const bool null)
+{
+  if (depth <= 0) { return qsearch(alpha, beta, ply); }
+
+  _pv[ply].length = 0;
+  count_node();
+
+  if (stopped()) { return 0; }
+
+  const bool pv_node = beta - alpha > 1;
+  const bool root = ply == 0;
+  transposition_table_t& tt = _owner._tt;
+
+  if (!root) {
+    if (_board.is_draw()) { return VALUE_DRAW; }
+    if (ply >= MAX_PLY - 1) { return static_evaluation(); }
+
+    // Mate distance pruning
+    alpha = std::max(alpha, -VALUE_MATE + ply);
+    beta = std::min(beta, VALUE_MATE - ply - 1);
+    if (alpha >= beta) { return alpha; }
+  }
+
+  /*****************************************************************************
+   * Transposition table
+   ****************************************************************************/
+  tt_data_t entry;
+  const bool tt_hit = tt.probe(_board.key(), entry, _id);
+  const uint16_t tt_move = tt_hit ? entry.move : NO_PACKED_MOVE;
+
+  _stats.add(STAT_TT_PROBES);
+  if (tt_hit) { _stats.add(STAT_TT_HITS); }
+
+  if (tt_hit && !pv_node && entry.depth >= depth) {
+    const int score = score_from_tt(entry.score, ply);
+
+    if (entry.bound == bound_t::EXACT ||
+        (entry.bound == bound_t::LOWER && score >= beta) ||
+        (entry.bound == bound_t::UPPER && score <= alpha)) {
+      _stats.add(STAT_TT_CUTOFFS);
+      return score;
+    }
+  }
+
+  /*****************************************************************************
+   * Tablebases
+   *
+   * Wins and losses are bounds, the search may still find a faster mate.
+   * The fifty moves rule is ignored: cursed wins and blessed losses are
+   * draws.
+   ****************************************************************************/
+  int max_score = VALUE_INFINITE;
+  int tb_best_score = -VALUE_INFINITE;
+  syzygy::wdl_t wdl;
+
+  if (!root && probe_tablebases(depth, wdl)) {
+    int score = VALUE_DRAW;
+    bound_t bound = bound_t::EXACT;
+
+    if (wdl == syzygy::wdl_t::WIN) {
+      score = VALUE_TB_WIN - ply;
+      bound = bound_t::LOWER;
+    } else if (wdl == syzygy::wdl_t::LOSS) {
+      score = -VALUE_TB_WIN + ply;
+      bound = bound_t::UPPER;
+    }
+
+    if (bound == bound_t::EXACT ||
+        (bound == bound_t::LOWER && score >= beta) ||
+        (bound == bound_t::UPPER && score <= alpha)) {
+      const int eval = _board.in_check() ? -VALUE_INFINITE : static_evaluation();
+      tt.store(_board.key(), std::min(depth + 6, MAX_PLY - 1),
+               score_to_tt(score, ply), eval, bound, NO_PACKED_MOVE);
+      return score;
+    }
+
+    if (pv_node) {
+      if (bound == bound_t::LOWER) {
+        tb_best_score = score;
+        alpha = std::max(alpha, score);
+      } else {
+        max_score = score;
+      }
+    }
+  }
+
+  const bool in_check = _board.in_check();
+  int static_eval = -VALUE_INFINITE;
+  if (!in_check) {
+    static_eval = tt_hit ? entry.eval : static_evaluation();
+  }
+
+  /*****************************************************************************
+   * Null move pruning
+   *
+   * If passing the turn still fails high the position is good enough. Not in
+   * pawn endgames where zugzwang is common.
+   ****************************************************************************/
+  if (!pv_node && !in_check && null && depth >= 3 && static_eval >= beta &&
+      _board.has_non_pawn_material(_board.active_color())) {
+    const int r = 2 + depth / 4;
+
+    _stats.add(STAT_NULL_TRIES);
+    make_null_move();
+    tt.prefetch(_board.key());
+    const int score = -search(-beta, -beta + 1, depth - 1 - r, ply + 1, false);
+    unmake_null_move();
+
+    if (stopped()) { return 0; }
+    if (score >= beta) {
+      _stats.add(STAT_NULL_CUTOFFS);
+      return score >= VALUE_MATE_IN_MAX_PLY ? beta : score;
+    }
+  }
+
+  // Check extension
+  if (in_check) { ++depth; }
+
+  const move_t previous = _board.last_move();
+  const move_t counter = previous == NULL_MOVE
+                             ? NULL_MOVE
+                             : _history.counter(_board, previous);
+  move_picker_t picker(_board, _history, tt_move, _killers[ply], counter);
+
+  const int old_alpha = alpha;
+  int best_score = tb_best_score;
+  uint16_t best_move = NO_PACKED_MOVE;
+  move_list_t failed_quiets;
+  move_t m;
+  size_t i = 0;
+
+  while (picker.next(m)) {
+    // Moves the tablebases proved worse than the others
+    if (root && !_owner.is_root_move(m)) { continue; }
+
+    const bool quiet = !m.is_capture() && !m.is_promotion();
+
+    make_move(m);
+    tt.prefetch(_board.key());
+
+    int score = 0;
+    if (i == 0) {
+      score = -search(-beta, -alpha, depth - 1, ply + 1, true);
+    } else {
+      // Late move reductions for the quiet moves at the end of the list
+      int reduction = 0;
+      if (depth >= 3 && i >= 3 && quiet && !in_check) {
+        reduction = lmr_table[std::min(depth, 63)][std::min<size_t>(i, 63)];
+        if (pv_node) { --reduction; }
+        reduction = std::clamp(reduction, 0, depth - 2);
+        if (reduction > 0) { _stats.add(STAT_LMR_REDUCTIONS); }
+      }
+
+      // Principal variation search: prove the move is not better with a null
+      // window, search it again with the full window only if it is.
+      score = -search(-alpha - 1, -alpha, depth - 1 - reduction, ply + 1, true);
+
+      if (score > alpha && reduction > 0) {
+        _stats.add(STAT_LMR_RESEARCHES);
+        score = -search(-alpha - 1, -alpha, depth - 1, ply + 1, true);
+      }
+
+      if (score > alpha && score < beta) {
+        _stats.add(STAT_PVS_RESEARCHES);
+        score = -search(-beta, -alpha, depth - 1, ply + 1, true);
+      }
+    }
+
+    unmake_move();
+    ++i;
+
+    if (stopped()) { return 0; }
+
+    if (score > best_score) {
+      best_score = score;
+
+      if (score > alpha) {
+        alpha = score;
+        best_move = pack_move(m);
+        update_pv(ply, m);
+
+        if (alpha >= beta) {
+          _stats.cutoff(i - 1);
+          if (quiet) { update_quiet_stats(m, failed_quiets, depth, ply); }
+          break;
+        }
+      }
+    }
+
+    if (quiet) { failed_quiets.push_back(m); }
+  }
+
+  // No legal move
+  if (i == 0) { return in_check ? -VALUE_MATE + ply : VALUE_DRAW; }
+
+  best_score = std::min(best_score, max_score);
+
+  bound_t bound = bound_t::UPPER;
+  if (best_score >= beta) {
+    bound = bound_t::LOWER;
+  } else if (best_score > old_alpha) {
+    bound = bound_t::EXACT;
+  }
+
+  tt.store(_board.key(), depth, score_to_tt(best_score, ply), static_eval,
+           bound, best_move);
+
+  return best_score;
+}
+
+
+void search_thread_t::iterative_deepening()
+{
+  const search_limits_t& limits = _owner._limits;
+  int score = 0;
+
+  // Helpers search one ply deeper every other thread, so they don't all walk
+  // the same tree in lockstep.
+  const int offset = is_main() ? 0 : static_cast<int>(_id & 1);
+
+  for (int depth = 1; depth <= limits.depth; ++depth) {
+    const int search_depth = std::min(depth + offset, MAX_PLY - 1);
+    int alpha = -VALUE_INFINITE;
+    int beta = VALUE_INFINITE;
+    int delta = ASPIRATION_WINDOW;
+
+    if (depth >= ASPIRATION_DEPTH) {
+      alpha = std::max(score - delta, -VALUE_INFINITE);
+      beta = std::min(score + delta, static_cast<int>(VALUE_INFINITE));
+    }
+
+    // Aspiration windows: widen on the failing side until the score fits
+    const int64_t iteration_start_us = SEARCH_STATS ? now_us() : 0;
+    int result = 0;
+    while (true) {
+      _seldepth = 0;
+      result = search(alpha, beta, search_depth, 0, false);
+
+      if (stopped()) { break; }
+
+      if (result <= alpha) {
+        beta = (alpha + beta) / 2;
+        alpha = std::max(result - delta, -VALUE_INFINITE);
+      } else if (result >= beta) {
+        beta = std::min(result + delta, static_cast<int>(VALUE_INFINITE));
+      } else {
+        break;
+      }
+
+      delta += delta / 2;
+    }
+
+    if (stopped()) { break; }
+
+    score = result;
+    best_score = result;
+    best_pv = _pv[0];
+    completed_depth = search_depth;
+
+    if (!is_main()) { continue; }
+
+    if constexpr (SEARCH_STATS) {
+      _stats.depth_time(search_depth, now_us() - iteration_start_us);
+    }
+
+    if (_owner.on_info) {
+      search_info_t info;
+      info.depth = search_depth;
+      info.seldepth = std::max(_seldepth, search_depth);
+      info.score = result;
+      info.nodes = _owner.nodes();
+      info.time_ms = _owner.elapsed_ms();
+      info.nps = info.nodes * 1000 / std::max<int64_t>(info.time_ms, 1);
+      info.tb_hits = _owner.tb_hits();
+      info.hashfull = _owner._tt.hashfull();
+      info.pv = best_pv;
+      _owner.on_info(info);
+    }
+
+    // A mate shorter than the depth can't get any better
+    if (!limits.infinite && std::abs(result) >= VALUE_MATE_IN_MAX_PLY &&
+        VALUE_MATE - std::abs(result) <= search_depth) {
+      break;
+    }
+
+    // Don't start an iteration we won't be able to finish
+    if (!_owner._ponder.load() && _owner._soft_limit_ms &&
+        _owner.elapsed_ms() >= _owner._soft_limit_ms / 2) {
+      break;
+    }
+  }
+}
+
+
+/*******************************************************************************
+ * Search
+ ******************************************************************************/
+search_t::search_t(transposition_table_t& tt) : _tt(tt) {}
+
+
+search_t::~search_t()
+{
+  stop();
+  wait();
+}
+
+
+void search_t::clear()
+{
+  stop();
+  wait();
+
+  for (auto& I : _threads) {
+    I->clear();
+  }
+}
+
+
+void search_t::set_threads(const size_t n)
+{
+  _thread_count = std::clamp<size_t>(n, 1, MAX_SEARCH_THREADS);
+}
+
+
+int64_t search_t::elapsed_ms() const
+{
+  return now_ms() - _start_ms.load(std::memory_order_relaxed);
+}
+
+
+uint64_t search_t::nodes() const
+{
+  uint64_t total = 0;
+  for (const auto& I : _threads) {
+    total += I->nodes();
+  }
+
+  return total;
+}
+
+
+uint64_t search_t::tb_hits() const
+{
+  uint64_t total = 0;
+  for (const auto& I : _threads) {
+    total += I->tb_hits();
+  }
+
+  return total;
+}
+
+
+search_stats_t search_t::stats() const
+{
+  search_stats_t res;
+  if constexpr (!SEARCH_STATS) { return res; }
+
+  res.threads = _threads.size();
+  res.time_ms = elapsed_ms();
+  res.nodes = nodes();
+
+  for (const auto& I : _threads) {
+    res += I->stats().snapshot();
+  }
+
+  return res;
+}
+
+
+bool search_t::is_root_move(const move_t& m) const
+{
+  return _root_moves.empty() ||
+         std::find(_root_moves.begin(), _root_moves.end(), m) !=
+             _root_moves.end();
+}
+
+
+void search_t::check_limits()
+{
+  // The main thread always finishes the first iteration so we have a move
+  if (_threads[0]->completed_depth == 0) { return; }
+
+  if (_limits.nodes && nodes() >= _limits.nodes) { stop(); }
+
+  // While pondering the clock is not ours
+  if (_ponder.load(std::memory_order_relaxed)) { return; }
+
+  if (_hard_limit_ms && elapsed_ms() >= _hard_limit_ms) { stop(); }
+}
+
+
+void search_t::setup(const board_t& board, const search_limits_t& limits)
+{
+  stop();
+  wait();
+
+  _limits = limits;
+  _start_ms = now_ms();
+  _stop = false;
+  _ponder = limits.ponder;
+  _soft_limit_ms = 0;
+  _hard_limit_ms = 0;
+
+  /*****************************************************************************
+   * Time management
+   ****************************************************************************/
+  const int us = static_cast<int>(board.active_color());
+  if (limits.movetime) {
+    _hard_limit_ms = limits.movetime;
+  } else if (!limits.infinite && limits.time[us] > 0) {
+    const int64_t time = limits.time[us];
+    const int64_t inc = limits.inc[us];
+    const int64_t moves_to_go =
+        limits.movestogo ? std::min(limits.movestogo, 50) : 30;
+    const int64_t available = std::max<int64_t>(time - MOVE_OVERHEAD_MS, 1);
+
+    _soft_limit_ms = std::min(time / moves_to_go + inc * 3 / 4, available);
+    _hard_limit_ms = std::min(_soft_limit_ms * 4, available);
+    _soft_limit_ms = std::max<int64_t>(_soft_limit_ms, 1);
+  }
+
+  while (_threads.size() < _thread_count) {
+    _threads.push_back(
+        std::make_unique<search_thread_t>(*this, _threads.size()));
+  }
+  _threads.resize(_thread_count);
+
+  for (auto& I : _threads) {
+    I->prepare(board);
+  }
+
+  // Only the moves keeping the tablebase result are searched
+  _root_moves.clear();
+  if (_tablebases && _tablebases->max_pieces()) {
+    board_t root = board;
+    move_list_t moves;
+    root.generate_legal_moves(moves);
+
+    if (_tablebases->filter_root_moves(root, moves)) { _root_moves = moves; }
+  }
+
+  _tt.new_search();
+}
+
+
+void search_t::start(const board_t& board, const search_limits_t& limits)
+{
+  setup(board, limits);
+  _running = true;
+  _control = std::thread(&search_t::run, this);
+}
+
+
+void search_t::search(const board_t& board, const search_limits_t& limits)
+{
+  setup(board, limits);
+  _running = true;
+  run();
+}
+
+
+void search_t::run()
+{
+  for (size_t i = 1; i < _threads.size(); ++i) {
+    _threads[i]->start();
+  }
+
+  search_thread_t& main = *_threads[0];
+  main.iterative_deepening();
+
+  // In infinite and ponder mode the best move waits for stop or ponderhit
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this] {
+      return _stop.load() || (!_limits.infinite && !_ponder.load());
+    });
+  }
+
+  _stop = true;
+  for (size_t i = 1; i < _threads.size(); ++i) {
+    _threads[i]->join();
+  }
+
+  move_t best = NULL_MOVE;
+  move_t ponder = NULL_MOVE;
+
+  if (main.best_pv.length > 0) {
+    best = main.best_pv.moves[0];
+    if (main.best_pv.length > 1) { ponder = main.best_pv.moves[1]; }
+  } else {
+    // Stopped before the first iteration: any legal move will do
+    best = main.first_legal_move();
+  }
+
+  if (on_bestmove) { on_bestmove(best, ponder); }
+
+  _running = false;
+}
+
+
+void search_t::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _cv.notify_all();
+}
+
+
+void search_t::ponderhit()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _start_ms = now_ms();
+    _ponder = false;
+  }
+  _cv.notify_all();
+}
+
+
+void search_t::wait()
+{
+  if (_control.joinable()) { _control.join(); }
+}
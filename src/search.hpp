@@ -0,0 +1,215 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "search_stats.hpp"
+#include "tt.hpp"
+
+static constexpr int MAX_PLY = 128;
+static constexpr int VALUE_DRAW = 0;
+static constexpr int VALUE_INFINITE = 32000;
+static constexpr int VALUE_MATE = 31000;
+static constexpr int VALUE_MATE_IN_MAX_PLY = VALUE_MATE - MAX_PLY;
+static constexpr int VALUE_TB_WIN = VALUE_MATE_IN_MAX_PLY - 1;
+static constexpr int VALUE_TB_WIN_IN_MAX_PLY = VALUE_TB_WIN - MAX_PLY;
+static constexpr size_t MAX_SEARCH_THREADS = MAX_TT_THREADS;
+
+
+/**
+ * What to search. Times are in milliseconds, 0 means no limit. time and inc
+ * are indexed by color_t.
+ */
+struct search_limits_t
+{
+  int depth = MAX_PLY - 1;
+  uint64_t nodes = 0;
+  int64_t movetime = 0;
+  std::array<int64_t, 2> time = {0, 0};
+  std::array<int64_t, 2> inc = {0, 0};
+  int movestogo = 0;
+  bool infinite = false;
+  bool ponder = false;
+};
+
+
+struct pv_t
+{
+  std::array<move_t, MAX_PLY> moves;
+  int length = 0;
+};
+
+
+/**
+ * Reported after every completed iteration of the main thread
+ */
+struct search_info_t
+{
+  int depth = 0;
+  int seldepth = 0;
+  int score = 0;
+  uint64_t nodes = 0;
+  uint64_t nps = 0;
+  uint64_t tb_hits = 0;
+  int64_t time_ms = 0;
+  int hashfull = 0;
+  pv_t pv;
+
+  inline bool is_mate() const
+  {
+    return score >= VALUE_MATE_IN_MAX_PLY || score <= -VALUE_MATE_IN_MAX_PLY;
+  }
+
+  // Moves (not plies) to mate, negative if we are getting mated
+  inline int mate_in() const
+  {
+    return score > 0 ? (VALUE_MATE - score + 1) / 2 : -(VALUE_MATE + score) / 2;
+  }
+};
+
+
+class search_thread_t;
+
+namespace nnue {
+struct network_t;
+}
+
+namespace syzygy {
+class tablebases_t;
+}
+
+
+/**
+ * Lazy SMP alpha-beta search.
+ *
+ * start() copies the board into every worker and returns immediately. All
+ * the workers run the same iterative deepening loop and only talk to each
+ * other through the shared transposition table. The worker 0 is the control
+ * thread: it checks the time and node limits, reports the search info and
+ * calls on_bestmove when the search is over.
+ */
+class search_t
+{
+  friend class search_thread_t;
+
+private:
+  transposition_table_t& _tt;
+  const nnue::network_t* _network = nullptr;
+  syzygy::tablebases_t* _tablebases = nullptr;
+  int _tb_probe_depth = 1;
+  int _tb_probe_limit = 0;
+  size_t _thread_count = 1;
+  std::vector<std::unique_ptr<search_thread_t>> _threads;
+  std::thread _control;
+
+  search_limits_t _limits;
+  move_list_t _root_moves;  // Empty unless filtered by the tablebases
+  std::atomic<int64_t> _start_ms{0};
+  int64_t _soft_limit_ms = 0;
+  int64_t _hard_limit_ms = 0;
+
+  std::atomic<bool> _stop{false};
+  std::atomic<bool> _ponder{false};
+  std::atomic<bool> _running{false};
+  std::mutex _mutex;
+  std::condition_variable _cv;
+
+  void setup(const board_t& board, const search_limits_t& limits);
+  void run();
+  void check_limits();
+  int64_t elapsed_ms() const;
+  uint64_t nodes() const;
+  uint64_t tb_hits() const;
+  bool is_root_move(const move_t& m) const;
+
+public:
+  explicit search_t(transposition_table_t& tt);
+  ~search_t();
+
+  search_t(const search_t&) = delete;
+  search_t& operator=(const search_t&) = delete;
+
+  /**
+   * Number of workers, takes effect at the next start()
+   */
+  void set_threads(const size_t n);
+  inline size_t threads() const { return _thread_count; }
+
+  /**
+   * Evaluate with this network from the next start(), the handcrafted
+   * evaluation if null. The network must outlive the searches.
+   */
+  inline void set_network(const nnue::network_t* network)
+  {
+    _network = network;
+  }
+
+  /**
+   * Probe these tablebases from the next start(), none if null. At the root
+   * only the moves keeping the tablebase result are searched, in the tree
+   * the positions right after a capture or a pawn move with at most limit
+   * pieces (all the tables if 0) and depth left are scored by WDL. The
+   * tablebases must outlive the searches.
+   */
+  inline void set_tablebases(syzygy::tablebases_t* tablebases,
+                             const int depth = 1,
+                             const int limit = 0)
+  {
+    _tablebases = tablebases;
+    _tb_probe_depth = depth;
+    _tb_probe_limit = limit;
+  }
+
+  /**
+   * Forget the move ordering statistics of the previous searches: history,
+   * countermoves and killers. After it a search gives the same result as a
+   * fresh search_t with the same transposition table. Waits for a running
+   * search.
+   */
+  void clear();
+
+  /**
+   * Start searching the position in the background. A running search is
+   * stopped first.
+   */
+  void start(const board_t& board, const search_limits_t& limits);
+
+  /**
+   * Same as start() but the calling thread is the control thread: returns
+   * once on_bestmove has been called. Meant for batch jobs with many short
+   * searches, infinite and ponder limits would never return.
+   */
+  void search(const board_t& board, const search_limits_t& limits);
+
+  /**
+   * Ask the search to stop as soon as possible. Doesn't block.
+   */
+  void stop();
+
+  /**
+   * The opponent played the ponder move: the clock starts running now
+   */
+  void ponderhit();
+
+  /**
+   * Block until the search is over and on_bestmove has been called
+   */
+  void wait();
+
+  inline bool is_running() const { return _running.load(); }
+
+  /**
+   * The statistics of the workers summed. Meant for the callbacks and
+   * between searches, all zeros if compiled without them.
+   */
+  search_stats_t stats() const;
+
+  std::function<void(const search_info_t&)> on_info;
+  std::function<void(const move_t& best, const move_t& ponder)> on_bestmove;
+};
@@ -0,0 +1,96 @@
+#include "search_stats.hpp"
+#include <sstream>
+
+static constexpr std::array<const char*, STATS> STAT_NAMES = {
+    "qnodes",         "tt_probes",      "tt_hits",
+    "tt_cutoffs",     "null_tries",     "null_cutoffs",
+    "lmr_reductions", "lmr_researches", "pvs_researches"};
+
+
+search_stats_t& search_stats_t::operator+=(const search_stats_t& other)
+{
+  threads += other.threads;
+  time_ms += other.time_ms;
+  nodes += other.nodes;
+
+  for (size_t i = 0; i < STATS; ++i) {
+    counters[i] += other.counters[i];
+  }
+
+  for (size_t i = 0; i < CUTOFF_BUCKETS; ++i) {
+    cutoffs[i] += other.cutoffs[i];
+  }
+
+  for (size_t i = 0; i < STATS_DEPTHS; ++i) {
+    depth_time_us[i] += other.depth_time_us[i];
+  }
+
+  return *this;
+}
+
+
+std::string search_stats_t::to_json() const
+{
+  std::ostringstream ss;
+  ss << "{\"threads\":" << threads << ",\"time_ms\":" << time_ms
+     << ",\"nodes\":" << nodes;
+
+  for (size_t i = 0; i < STATS; ++i) {
+    ss << ",\"" << STAT_NAMES[i] << "\":" << counters[i];
+  }
+
+  ss << ",\"cutoff_index\":[";
+  for (size_t i = 0; i < CUTOFF_BUCKETS; ++i) {
+    ss << (i ? "," : "") << cutoffs[i];
+  }
+
+  // Depth 0 is never searched, the list stops at the last iteration timed
+  size_t depths = STATS_DEPTHS;
+  while (depths > 1 && depth_time_us[depths - 1] == 0) {
+    --depths;
+  }
+
+  ss << "],\"depth_time_us\":[";
+  for (size_t i = 1; i < depths; ++i) {
+    ss << (i > 1 ? "," : "") << depth_time_us[i];
+  }
+  ss << "]}";
+
+  return ss.str();
+}
+
+
+void search_counters_t::clear()
+{
+  for (auto& I : counters) {
+    I.store(0, std::memory_order_relaxed);
+  }
+
+  for (auto& I : cutoffs) {
+    I.store(0, std::memory_order_relaxed);
+  }
+
+  for (auto& I : depth_time_us) {
+    I.store(0, std::memory_order_relaxed);
+  }
+}
+
+
+search_stats_t search_counters_t::snapshot() const
+{
+  search_stats_t res;
+
+  for (size_t i = 0; i < STATS; ++i) {
+    res.counters[i] = counters[i].load(std::memory_order_relaxed);
+  }
+
+  for (size_t i = 0; i < CUTOFF_BUCKETS; ++i) {
+    res.cutoffs[i] = cutoffs[i].load(std::memory_order_relaxed);
+  }
+
+  for (size_t i = 0; i < STATS_DEPTHS; ++i) {
+    res.depth_time_us[i] = depth_time_us[i].load(std::memory_order_relaxed);
+  }
+
+  return res;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Built with the statistics unless told otherwise, see CHESSO_SEARCH_STATS
+#if !defined(CHESSO_SEARCH_STATS)
+#define CHESSO_SEARCH_STATS 1
+#endif
+
+
+/*******************************************************************************
+ * Search statistics
+ *
+ * Every worker counts in its own cache line aligned block, nothing is shared
+ * while searching. search_t::stats() sums the blocks when asked. With
+ * CHESSO_SEARCH_STATS=0 the counting compiles to nothing.
+ ******************************************************************************/
+static constexpr bool SEARCH_STATS = CHESSO_SEARCH_STATS;
+
+// Beta cutoffs by index of the move that caused them, the last bucket is
+// that index and all the later ones
+static constexpr size_t CUTOFF_BUCKETS = 16;
+static constexpr size_t STATS_DEPTHS = 128;
+
+
+enum stat_t : uint8_t
+{
+  STAT_QNODES,
+  STAT_TT_PROBES,
+  STAT_TT_HITS,
+  STAT_TT_CUTOFFS,
+  STAT_NULL_TRIES,
+  STAT_NULL_CUTOFFS,
+  STAT_LMR_REDUCTIONS,
+  STAT_LMR_RESEARCHES,
+  STAT_PVS_RESEARCHES,
+  STATS
+};
+
+
+/**
+ * The counters of all the workers summed
+ */
+struct search_stats_t
+{
+  size_t threads = 0;
+  int64_t time_ms = 0;
+  uint64_t nodes = 0;
+  std::array<uint64_t, STATS> counters = {};
+  std::array<uint64_t, CUTOFF_BUCKETS> cutoffs = {};
+
+  // Microseconds the main thread spent on every iteration
+  std::array<uint64_t, STATS_DEPTHS> depth_time_us = {};
+
+  search_stats_t& operator+=(const search_stats_t& other);
+
+  /**
+   * One line of JSON
+   */
+  std::string to_json() const;
+};
+
+
+/**
+ * The counters of one worker. Only that worker writes them, so a relaxed
+ * load and store is enough and no read-modify-write is needed.
+ */
+struct alignas(64) search_counters_t
+{
+  std::array<std::atomic<uint64_t>, STATS> counters;
+  std::array<std::atomic<uint64_t>, CUTOFF_BUCKETS> cutoffs;
+  std::array<std::atomic<uint64_t>, STATS_DEPTHS> depth_time_us;
+
+  search_counters_t() { clear(); }
+
+  void clear();
+
+  /**
+   * The counters read from any thread, summed with search_stats_t::operator+=
+   */
+  search_stats_t snapshot() const;
+
+  inline void add(const stat_t stat)
+  {
+    if constexpr (SEARCH_STATS) { bump(counters[stat]); }
+  }
+
+  inline void cutoff(const size_t index)
+  {
+    if constexpr (SEARCH_STATS) {
+      bump(cutoffs[index < CUTOFF_BUCKETS ? index : CUTOFF_BUCKETS - 1]);
+    }
+  }
+
+  inline void depth_time(const int depth, const uint64_t us)
+  {
+    if constexpr (SEARCH_STATS) {
+      if (depth >= 0 && static_cast<size_t>(depth) < STATS_DEPTHS) {
+        depth_time_us[depth].store(us, std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  static inline void bump(std::atomic<uint64_t>& counter)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  }
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+
+/**
+ * Lock-free single producer / single consumer snapshot (triple buffer).
+ *
+ * The producer always writes into its own slot and swaps it with the middle
+ * one, the consumer swaps its slot with the middle one only when something
+ * new was published. Neither side ever waits for the other and the consumer
+ * always sees a complete value, the newest one.
+ */
+template <typename T>
+class snapshot_t
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "The snapshot is copied as a whole");
+
+private:
+  static constexpr uint8_t INDEX_MASK = 0x03;
+  static constexpr uint8_t FRESH = 0x04;
+
+  struct alignas(64) slot_t
+  {
+    T value;
+  };
+
+  std::array<slot_t, 3> _slots = {};
+  alignas(64) std::atomic<uint8_t> _middle{2};
+  alignas(64) uint8_t _write = 0;  // Producer side
+  alignas(64) uint8_t _read = 1;   // Consumer side
+
+public:
+  /**
+   * Producer only
+   */
+  inline void publish(const T& value)
+  {
+    _slots[_write].value = value;
+    _write = _middle.exchange(_write | FRESH, std::memory_order_acq_rel) &
+             INDEX_MASK;
+  }
+
+  /**
+   * Consumer only. Take the newest value if there is one, return true if the
+   * latest() value changed.
+   */
+  inline bool update()
+  {
+    if (!(_middle.load(std::memory_order_relaxed) & FRESH)) { return false; }
+
+    _read = _middle.exchange(_read, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+
+  /**
+   * Consumer only
+   */
+  inline const T& latest() const { return _slots[_read].value; }
+};
@@ -0,0 +1,1239 @@
+#include "syzygy.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include "bitboard.hpp"
+#include "exceptions.hpp"
+#include "mapped_file.hpp"
+
+namespace syzygy {
+
+static constexpr std::array<uint8_t, 4> WDL_MAGIC = {0x71, 0xE8, 0x23, 0x5D};
+static constexpr std::array<uint8_t, 4> DTZ_MAGIC = {0xD7, 0x66, 0x0C, 0xA5};
+static constexpr const char* WDL_SUFFIX = ".rtbw";
+static constexpr const char* DTZ_SUFFIX = ".rtbz";
+
+#if defined(_WIN32)
+static constexpr char PATH_SEPARATOR = ';';
+#else
+static constexpr char PATH_SEPARATOR = ':';
+#endif
+
+// Outcome of a probe
+static constexpr int PROBE_FAIL = 0;
+static constexpr int PROBE_OK = 1;
+static constexpr int PROBE_CHANGE_STM = -1;  // DTZ stored for the other side
+static constexpr int PROBE_ZEROING = 2;      // Best move is a capture or pawn
+
+// Per table flags
+static constexpr uint8_t FLAG_STM = 1;
+static constexpr uint8_t FLAG_MAPPED = 2;
+static constexpr uint8_t FLAG_WIN_PLIES = 4;
+static constexpr uint8_t FLAG_LOSS_PLIES = 8;
+static constexpr uint8_t FLAG_WIDE = 16;
+static constexpr uint8_t FLAG_SINGLE_VALUE = 128;
+
+static constexpr int NO_DTZ = 0xFFFF;
+
+
+/*******************************************************************************
+ * Helpers
+ *
+ * The tables are little endian, except the compressed blocks which are read
+ * as big endian words.
+ ******************************************************************************/
+static inline uint16_t read_le16(const uint8_t* p)
+{
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+
+static inline uint32_t read_le32(const uint8_t* p)
+{
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+
+static inline uint32_t read_be32(const uint8_t* p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+
+static inline uint64_t read_be64(const uint8_t* p)
+{
+  return (static_cast<uint64_t>(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+
+static inline int file_of(const uint8_t sq) { return sq & 7; }
+static inline int rank_of(const uint8_t sq) { return sq >> 3; }
+
+// Negative below the a1-h8 diagonal, 0 on it
+static inline int off_diagonal(const uint8_t sq)
+{
+  return rank_of(sq) - file_of(sq);
+}
+
+
+static inline int sign_of(const int v) { return (v > 0) - (v < 0); }
+
+
+/**
+ * DTZ of a position whose best move is a capture or a pawn move
+ */
+static inline int dtz_before_zeroing(const wdl_t wdl)
+{
+  switch (wdl) {
+    case wdl_t::WIN:
+      return 1;
+    case wdl_t::CURSED_WIN:
+      return 101;
+    case wdl_t::BLESSED_LOSS:
+      return -101;
+    case wdl_t::LOSS:
+      return -1;
+    default:
+      return 0;
+  }
+}
+
+
+static inline wdl_t negate(const wdl_t wdl)
+{
+  return static_cast<wdl_t>(-static_cast<int>(wdl));
+}
+
+
+/**
+ * One nibble per piece count, white then black, pawns to kings. Both the
+ * table names and the positions map to it.
+ */
+using material_t = std::array<std::array<int, 7>, 2>;
+
+static uint64_t material_key(const material_t& material)
+{
+  uint64_t key = 0;
+  for (int side = 0; side < 2; ++side) {
+    for (uint8_t type = PAWN; type <= KING; ++type) {
+      key |= static_cast<uint64_t>(material[side][type] & 0xF)
+             << (4 * (side * 6 + type - 1));
+    }
+  }
+
+  return key;
+}
+
+
+static uint64_t material_key(const board_t& board)
+{
+  material_t material;
+  for (uint8_t type = PAWN; type <= KING; ++type) {
+    material[0][type] = popcount(board.pieces_bb(color_t::WHITE, type));
+    material[1][type] = popcount(board.pieces_bb(color_t::BLACK, type));
+  }
+
+  return material_key(material);
+}
+
+
+/*******************************************************************************
+ * Index encoding
+ *
+ * A position is turned into an index by encoding groups of pieces: the
+ * leading group (the pawns closest to the edge, or the kings and up to one
+ * more piece), then the other pawns, then each set of identical pieces. The
+ * board symmetries are used to bring the leading group into a small part of
+ * the board.
+ ******************************************************************************/
+struct encoding_t
+{
+  // binomial[k][n]: ways to choose k squares out of n
+  std::array<std::array<uint64_t, 64>, MAX_PIECES> binomial = {};
+
+  // a2-h7 to 0 - 47, the higher the closer to the edge and to rank 2
+  std::array<int, 64> map_pawns = {};
+
+  // Squares below the a1-h8 diagonal to 0 - 27
+  std::array<int, 64> map_b1h1h7 = {};
+
+  // The a1-d1-d4 triangle to 0 - 9, the diagonal last
+  std::array<int, 64> map_a1d1d4 = {};
+
+  // The 462 legal placements of two kings, the first in the triangle
+  std::array<std::array<int, 64>, 10> map_kk = {};
+
+  // Leading pawns [count][square] and their number of placements per file
+  std::array<std::array<int, 64>, MAX_PIECES> lead_pawn_idx = {};
+  std::array<std::array<uint64_t, 4>, MAX_PIECES> lead_pawns_size = {};
+};
+
+
+static const encoding_t encoding = [] {
+  encoding_t e;
+
+  int code = 0;
+  for (uint8_t sq = 0; sq < 64; ++sq) {
+    if (off_diagonal(sq) < 0) { e.map_b1h1h7[sq] = code++; }
+  }
+
+  std::vector<uint8_t> diagonal;
+  code = 0;
+  for (uint8_t sq = 0; sq < 28; ++sq) {
+    if (file_of(sq) > 3) { continue; }
+
+    if (off_diagonal(sq) < 0) {
+      e.map_a1d1d4[sq] = code++;
+    } else if (off_diagonal(sq) == 0) {
+      diagonal.push_back(sq);
+    }
+  }
+  for (const uint8_t I : diagonal) {
+    e.map_a1d1d4[I] = code++;
+  }
+
+  // If the first king is on the diagonal the other one is not above it,
+  // both on the diagonal come last
+  std::vector<std::pair<int, uint8_t>> both_on_diagonal;
+  code = 0;
+  for (int idx = 0; idx < 10; ++idx) {
+    for (uint8_t s1 = 0; s1 < 28; ++s1) {
+      // b1, code 0, is the only square of the triangle mapped to 0
+      if (e.map_a1d1d4[s1] != idx || (idx == 0 && s1 != 1)) { continue; }
+
+      for (uint8_t s2 = 0; s2 < 64; ++s2) {
+        const bool touching = std::abs(file_of(s1) - file_of(s2)) <= 1 &&
+                              std::abs(rank_of(s1) - rank_of(s2)) <= 1;
+
+        if (touching) { continue; }
+        if (!off_diagonal(s1) && off_diagonal(s2) > 0) { continue; }
+
+        if (!off_diagonal(s1) && !off_diagonal(s2)) {
+          both_on_diagonal.emplace_back(idx, s2);
+        } else {
+          e.map_kk[idx][s2] = code++;
+        }
+      }
+    }
+  }
+  for (const auto& I : both_on_diagonal) {
+    e.map_kk[I.first][I.second] = code++;
+  }
+
+  e.binomial[0][0] = 1;
+  for (int n = 1; n < 64; ++n) {
+    for (int k = 0; k < MAX_PIECES && k <= n; ++k) {
+      e.binomial[k][n] = (k > 0 ? e.binomial[k - 1][n - 1] : 0) +
+                         (k < n ? e.binomial[k][n - 1] : 0);
+    }
+  }
+
+  int available = 47;
+  for (int count = 1; count < MAX_PIECES - 1; ++count) {
+    for (int file = 0; file < 4; ++file) {
+      uint64_t idx = 0;
+
+      for (int rank = 1; rank < 7; ++rank) {
+        const uint8_t sq = rank * 8 + file;
+
+        // No other pawn can be closer to the edge or lower on the board
+        if (count == 1) {
+          e.map_pawns[sq] = available--;
+          e.map_pawns[sq ^ 7] = available--;
+        }
+
+        e.lead_pawn_idx[count][sq] = static_cast<int>(idx);
+        idx += e.binomial[count - 1][e.map_pawns[sq]];
+      }
+
+      e.lead_pawns_size[count][file] = idx;
+    }
+  }
+
+  return e;
+}();
+
+
+/*******************************************************************************
+ * Tables
+ ******************************************************************************/
+
+/**
+ * Compressed values of one side to move and one leading pawn file
+ */
+struct pairs_data_t
+{
+  uint8_t flags = 0;
+  int max_sym_len = 0;
+  int min_sym_len = 0;  // The value itself for FLAG_SINGLE_VALUE
+  uint64_t block_size = 0;
+  uint64_t span = 0;
+  uint64_t sparse_index_size = 0;
+  uint64_t blocks_num = 0;
+  uint64_t block_length_size = 0;
+
+  const uint8_t* lowest_sym = nullptr;    // uint16 per symbol length
+  const uint8_t* btree = nullptr;         // 3 bytes per symbol
+  const uint8_t* sparse_index = nullptr;  // uint32 block, uint16 offset
+  const uint8_t* block_length = nullptr;  // uint16 per block
+  const uint8_t* data = nullptr;
+
+  // Canonical Huffman code: lowest code of each length, left aligned
+  std::vector<uint64_t> base64;
+
+  // Number of values a symbol expands to, minus one
+  std::vector<uint8_t> symlen;
+
+  std::array<uint8_t, MAX_PIECES> pieces = {};
+  std::array<uint64_t, MAX_PIECES + 1> group_idx = {};
+  std::array<int, MAX_PIECES + 1> group_len = {};
+
+  // DTZ value maps, by WDL result
+  std::array<uint16_t, 4> map_idx = {};
+
+  inline int left(const int sym) const
+  {
+    const uint8_t* p = btree + 3 * sym;
+    return ((p[1] & 0xF) << 8) | p[0];
+  }
+
+  inline int right(const int sym) const
+  {
+    const uint8_t* p = btree + 3 * sym;
+    return (p[2] << 4) | (p[1] >> 4);
+  }
+};
+
+
+struct table_t
+{
+  std::string path;
+  bool dtz = false;
+
+  // Stronger side as white, and as black
+  uint64_t key = 0;
+  uint64_t key2 = 0;
+
+  int piece_count = 0;
+  bool has_pawns = false;
+  bool has_unique_pieces = false;
+
+  // Pawns of the leading color, then of the other one
+  std::array<int, 2> pawn_count = {};
+
+  // Set once, when the table is opened
+  std::atomic<bool> ready{false};
+  bool usable = false;
+  mapped_file_t file;
+  const uint8_t* map = nullptr;
+
+  // [side to move][leading pawn file], DTZ tables have one side only
+  std::array<std::array<pairs_data_t, 4>, 2> items;
+
+  inline pairs_data_t& get(const int stm, const int file)
+  {
+    return items[dtz ? 0 : stm][has_pawns ? file : 0];
+  }
+};
+
+
+/**
+ * Table of the material in name ("KRPvKR"), false if it is not one
+ */
+static bool parse_name(const std::string& name, table_t& table)
+{
+  const size_t v = name.find('v');
+  if (name.empty() || name[0] != 'K' || v == std::string::npos ||
+      v + 1 >= name.size() || name[v + 1] != 'K') {
+    return false;
+  }
+
+  material_t material = {};
+  for (size_t i = 0; i < name.size(); ++i) {
+    if (i == v) { continue; }
+
+    const size_t type = std::string(".PNBRQK").find(name[i]);
+    if (type == std::string::npos || type == 0) { return false; }
+
+    ++material[i < v ? 0 : 1][type];
+  }
+
+  if (material[0][KING] != 1 || material[1][KING] != 1) { return false; }
+
+  int pieces = 0;
+  for (const auto& side : material) {
+    for (uint8_t type = PAWN; type <= KING; ++type) {
+      pieces += side[type];
+      if (type != KING && side[type] == 1) { table.has_unique_pieces = true; }
+    }
+  }
+  if (pieces > MAX_PIECES) { return false; }
+
+  const int white_pawns = material[0][PAWN];
+  const int black_pawns = material[1][PAWN];
+
+  table.piece_count = pieces;
+  table.has_pawns = white_pawns + black_pawns > 0;
+
+  // The side with fewer pawns leads, it compresses better
+  const bool white_leads =
+      !black_pawns || (white_pawns && black_pawns >= white_pawns);
+  table.pawn_count[0] = white_leads ? white_pawns : black_pawns;
+  table.pawn_count[1] = white_leads ? black_pawns : white_pawns;
+
+  table.key = material_key(material);
+  std::swap(material[0], material[1]);
+  table.key2 = material_key(material);
+
+  return true;
+}
+
+
+static void set_groups(const table_t& t,
+                       pairs_data_t& d,
+                       const std::array<int, 2>& order,
+                       const int file)
+{
+  const encoding_t& e = encoding;
+
+  // The leading group is the kings and a unique piece, or the two kings, or
+  // the leading pawns. Then one group per run of identical pieces.
+  int n = 0;
+  int first_len = t.has_pawns ? 0 : t.has_unique_pieces ? 3 : 2;
+  d.group_len[n] = 1;
+
+  for (int i = 1; i < t.piece_count; ++i) {
+    if (--first_len > 0 || d.pieces[i] != d.pieces[i - 1]) {
+      d.group_len[++n] = 1;
+    } else {
+      d.group_len[n]++;
+    }
+  }
+  d.group_len[++n] = 0;
+
+  // The groups are encoded in a per-table order: order[0] is the position
+  // of the leading group and order[1] the one of the other pawns
+  const bool both_pawns = t.has_pawns && t.pawn_count[1];
+  int next = both_pawns ? 2 : 1;
+  int free_squares = 64 - d.group_len[0] - (both_pawns ? d.group_len[1] : 0);
+  uint64_t idx = 1;
+
+  for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+    if (k == order[0]) {
+      d.group_idx[0] = idx;
+      idx *= t.has_pawns           ? e.lead_pawns_size[d.group_len[0]][file]
+             : t.has_unique_pieces ? 31332
+                                   : 462;
+    } else if (k == order[1]) {
+      d.group_idx[1] = idx;
+      idx *= e.binomial[d.group_len[1]][48 - d.group_len[0]];
+    } else {
+      d.group_idx[next] = idx;
+      idx *= e.binomial[d.group_len[next]][free_squares];
+      free_squares -= d.group_len[next++];
+    }
+  }
+
+  d.group_idx[n] = idx;
+}
+
+
+static int set_symlen(pairs_data_t& d,
+                      const int sym,
+                      std::vector<bool>& visited)
+{
+  // The pairs form a tree, no symbol is reached twice on the way down
+  visited[sym] = true;
+
+  const int r = d.right(sym);
+  if (r == 0xFFF) { return 0; }
+
+  const int l = d.left(sym);
+  if (!visited[l]) { d.symlen[l] = set_symlen(d, l, visited); }
+  if (!visited[r]) { d.symlen[r] = set_symlen(d, r, visited); }
+
+  return d.symlen[l] + d.symlen[r] + 1;
+}
+
+
+static const uint8_t* set_sizes(pairs_data_t& d, const uint8_t* data)
+{
+  d.flags = *data++;
+
+  if (d.flags & FLAG_SINGLE_VALUE) {
+    d.min_sym_len = *data++;
+    return data;
+  }
+
+  // The last group index is the number of positions in the table
+  size_t last = 0;
+  while (d.group_len[last]) {
+    ++last;
+  }
+  const uint64_t size = d.group_idx[last];
+
+  d.block_size = 1ULL << *data++;
+  d.span = 1ULL << *data++;
+  d.sparse_index_size = (size + d.span - 1) / d.span;
+  const uint8_t padding = *data++;
+  d.blocks_num = read_le32(data);
+  data += 4;
+
+  // Padded so the sparse index never points past the end
+  d.block_length_size = d.blocks_num + padding;
+  d.max_sym_len = *data++;
+  d.min_sym_len = *data++;
+  d.lowest_sym = data;
+
+  // Longer codes have lower values, base64[i] >= base64[i + 1]
+  const int lengths = d.max_sym_len - d.min_sym_len + 1;
+  d.base64.assign(lengths, 0);
+  for (int i = lengths - 2; i >= 0; --i) {
+    d.base64[i] = (d.base64[i + 1] + read_le16(d.lowest_sym + 2 * i) -
+                   read_le16(d.lowest_sym + 2 * (i + 1))) /
+                  2;
+  }
+  for (int i = 0; i < lengths; ++i) {
+    d.base64[i] <<= 64 - i - d.min_sym_len;
+  }
+
+  data += 2 * lengths;
+  d.symlen.assign(read_le16(data), 0);
+  data += 2;
+  d.btree = data;
+
+  std::vector<bool> visited(d.symlen.size());
+  for (size_t sym = 0; sym < d.symlen.size(); ++sym) {
+    if (!visited[sym]) {
+      d.symlen[sym] = set_symlen(d, static_cast<int>(sym), visited);
+    }
+  }
+
+  return data + 3 * d.symlen.size() + (d.symlen.size() & 1);
+}
+
+
+static const uint8_t* set_dtz_map(table_t& t,
+                                  const uint8_t* base,
+                                  const uint8_t* data,
+                                  const int max_file)
+{
+  t.map = data;
+
+  // Four value maps per file, one per WDL result
+  for (int file = 0; file <= max_file; ++file) {
+    pairs_data_t& d = t.get(0, file);
+    if (!(d.flags & FLAG_MAPPED)) { continue; }
+
+    if (d.flags & FLAG_WIDE) {
+      data += (data - base) & 1;
+      for (int i = 0; i < 4; ++i) {
+        d.map_idx[i] = static_cast<uint16_t>((data - t.map) / 2 + 1);
+        data += 2 * read_le16(data) + 2;
+      }
+    } else {
+      for (int i = 0; i < 4; ++i) {
+        d.map_idx[i] = static_cast<uint16_t>(data - t.map + 1);
+        data += *data + 1;
+      }
+    }
+  }
+
+  return data + ((data - base) & 1);
+}
+
+
+/**
+ * Lay the pairs data over the mapped file, false if it is malformed
+ */
+static bool parse_table(table_t& t)
+{
+  const auto* base = reinterpret_cast<const uint8_t*>(t.file.data());
+  const uint8_t* end = base + t.file.size();
+  const uint8_t* data = base + 4;
+
+  if (t.file.size() < 16) { return false; }
+
+  const bool split = t.key != t.key2;
+  if (bool(*data & 2) != t.has_pawns || (!t.dtz && bool(*data & 1) != split)) {
+    return false;
+  }
+  ++data;
+
+  const int sides = !t.dtz && split ? 2 : 1;
+  const int max_file = t.has_pawns ? 3 : 0;
+  const bool both_pawns = t.has_pawns && t.pawn_count[1];
+
+  for (int file = 0; file <= max_file; ++file) {
+    const std::array<std::array<int, 2>, 2> order = {
+        {{data[0] & 0xF, both_pawns ? data[1] & 0xF : 0xF},
+         {data[0] >> 4, both_pawns ? data[1] >> 4 : 0xF}}};
+    data += 1 + both_pawns;
+
+    for (int k = 0; k < t.piece_count; ++k, ++data) {
+      for (int i = 0; i < sides; ++i) {
+        t.get(i, file).pieces[k] = i ? *data >> 4 : *data & 0xF;
+      }
+    }
+
+    for (int i = 0; i < sides; ++i) {
+      set_groups(t, t.get(i, file), order[i], file);
+    }
+  }
+
+  data += (data - base) & 1;
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      data = set_sizes(t.get(i, file), data);
+      if (data > end) { return false; }
+    }
+  }
+
+  if (t.dtz) { data = set_dtz_map(t, base, data, max_file); }
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      pairs_data_t& d = t.get(i, file);
+      d.sparse_index = data;
+      data += 6 * d.sparse_index_size;
+    }
+  }
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      pairs_data_t& d = t.get(i, file);
+      d.block_length = data;
+      data += 2 * d.block_length_size;
+    }
+  }
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      // Blocks start on a cache line
+      data += (64 - ((data - base) & 63)) & 63;
+
+      pairs_data_t& d = t.get(i, file);
+      d.data = data;
+      data += d.blocks_num * d.block_size;
+    }
+  }
+
+  return data <= end;
+}
+
+
+/**
+ * Value stored at index idx
+ */
+static int decompress_pairs(const pairs_data_t& d, const uint64_t idx)
+{
+  if (d.flags & FLAG_SINGLE_VALUE) { return d.min_sym_len; }
+
+  // The sparse index gives the block and offset of the value in the middle
+  // of every span, walk the blocks from there
+  const uint64_t k = idx / d.span;
+  uint32_t block = read_le32(d.sparse_index + 6 * k);
+  int offset = read_le16(d.sparse_index + 6 * k + 4);
+  offset += static_cast<int>(idx % d.span) - static_cast<int>(d.span / 2);
+
+  auto block_length = [&d](const uint32_t b) {
+    return static_cast<int>(read_le16(d.block_length + 2 * b));
+  };
+
+  while (offset < 0) {
+    offset += block_length(--block) + 1;
+  }
+  while (offset > block_length(block)) {
+    offset -= block_length(block++) + 1;
+  }
+
+  // Decode the symbols of the block until the one covering offset
+  const uint8_t* ptr = d.data + block * d.block_size;
+  uint64_t buf64 = read_be64(ptr);
+  ptr += 8;
+  int buf64_size = 64;
+  int sym = 0;
+
+  while (true) {
+    int len = 0;
+    while (buf64 < d.base64[len]) {
+      ++len;
+    }
+
+    sym = static_cast<int>((buf64 - d.base64[len]) >>
+                           (64 - len - d.min_sym_len));
+    sym += read_le16(d.lowest_sym + 2 * len);
+
+    if (offset < d.symlen[sym] + 1) { break; }
+
+    offset -= d.symlen[sym] + 1;
+    len += d.min_sym_len;
+    buf64 <<= len;
+    buf64_size -= len;
+
+    if (buf64_size <= 32) {
+      buf64_size += 32;
+      buf64 |= static_cast<uint64_t>(read_be32(ptr)) << (64 - buf64_size);
+      ptr += 4;
+    }
+  }
+
+  // The symbol stands for a pair of symbols, recursively: go down to the
+  // value at offset
+  while (d.symlen[sym]) {
+    const int l = d.left(sym);
+
+    if (offset < d.symlen[l] + 1) {
+      sym = l;
+    } else {
+      offset -= d.symlen[l] + 1;
+      sym = d.right(sym);
+    }
+  }
+
+  return d.left(sym);
+}
+
+
+static int map_score(table_t& t, const int file, int value, const wdl_t wdl)
+{
+  if (!t.dtz) { return value - 2; }
+
+  static constexpr std::array<int, 5> WDL_MAP = {1, 3, 0, 2, 0};
+
+  const pairs_data_t& d = t.get(0, file);
+  const int w = static_cast<int>(wdl);
+
+  if (d.flags & FLAG_MAPPED) {
+    const int i = d.map_idx[WDL_MAP[w + 2]] + value;
+    value = (d.flags & FLAG_WIDE) ? read_le16(t.map + 2 * i) : t.map[i];
+  }
+
+  // Stored in moves unless flagged in plies, we want plies
+  const bool in_moves = (wdl == wdl_t::WIN && !(d.flags & FLAG_WIN_PLIES)) ||
+                        (wdl == wdl_t::LOSS && !(d.flags & FLAG_LOSS_PLIES)) ||
+                        wdl == wdl_t::CURSED_WIN ||
+                        wdl == wdl_t::BLESSED_LOSS;
+  if (in_moves) { value *= 2; }
+
+  return value + 1;
+}
+
+
+/**
+ * Index of the position in the opened table, and the side to move and the
+ * leading pawn file of the pairs data holding it
+ */
+static uint64_t encode(table_t& t, const board_t& board, int& stm, int& file)
+{
+  const encoding_t& e = encoding;
+
+  std::array<uint8_t, MAX_PIECES> squares;
+  std::array<uint8_t, MAX_PIECES> pieces;
+  int size = 0;
+  int lead_count = 0;
+  bitboard_t lead_pawns = 0;
+  file = 0;
+
+  // The tables have the stronger side as white, and white to move only when
+  // both sides have the same material: flip the colors and the board if
+  // needed
+  const bool black = board.active_color() == color_t::BLACK;
+  const bool flip =
+      (t.key == t.key2 && black) || material_key(board) != t.key;
+  const uint8_t flip_color = flip ? BLACK_PIECE : 0;
+  const uint8_t flip_squares = flip ? 56 : 0;
+  stm = flip != black;
+
+  auto pawn_less = [&e](const uint8_t a, const uint8_t b) {
+    return e.map_pawns[a] < e.map_pawns[b];
+  };
+
+  if (t.has_pawns) {
+    // The leading pawns have the color of the first piece of the table
+    const uint8_t p = t.get(0, 0).pieces[0] ^ flip_color;
+    lead_pawns = board.pieces_bb(piece_color(p), PAWN);
+
+    bitboard_t b = lead_pawns;
+    while (b) {
+      squares[size++] = pop_lsb(b) ^ flip_squares;
+    }
+    lead_count = size;
+
+    std::swap(squares[0], *std::max_element(squares.begin(),
+                                            squares.begin() + lead_count,
+                                            pawn_less));
+    file = std::min(file_of(squares[0]), 7 - file_of(squares[0]));
+  }
+
+  bitboard_t b = board.occupied_bb() ^ lead_pawns;
+  while (b) {
+    const uint8_t sq = pop_lsb(b);
+    squares[size] = sq ^ flip_squares;
+    pieces[size++] = board.piece_at(to_index88(sq)) ^ flip_color;
+  }
+
+  const pairs_data_t& d = t.get(stm, file);
+
+  // Same order as the pieces of the table
+  for (int i = lead_count; i < size - 1; ++i) {
+    for (int j = i + 1; j < size; ++j) {
+      if (d.pieces[i] == pieces[j]) {
+        std::swap(pieces[i], pieces[j]);
+        std::swap(squares[i], squares[j]);
+        break;
+      }
+    }
+  }
+
+  // The leading piece goes to the a-d files
+  if (file_of(squares[0]) > 3) {
+    for (int i = 0; i < size; ++i) {
+      squares[i] ^= 7;
+    }
+  }
+
+  uint64_t idx = 0;
+
+  if (t.has_pawns) {
+    idx = e.lead_pawn_idx[lead_count][squares[0]];
+
+    std::stable_sort(squares.begin() + 1, squares.begin() + lead_count,
+                     pawn_less);
+    for (int i = 1; i < lead_count; ++i) {
+      idx += e.binomial[i][e.map_pawns[squares[i]]];
+    }
+  } else {
+    // Without pawns, to ranks 1-4 and below the a1-h8 diagonal too
+    if (rank_of(squares[0]) > 3) {
+      for (int i = 0; i < size; ++i) {
+        squares[i] ^= 56;
+      }
+    }
+
+    for (int i = 0; i < d.group_len[0]; ++i) {
+      if (!off_diagonal(squares[i])) { continue; }
+
+      if (off_diagonal(squares[i]) > 0) {
+        for (int j = i; j < size; ++j) {
+          squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+        }
+      }
+      break;
+    }
+
+    if (t.has_unique_pieces) {
+      const int s0 = squares[0];
+      const int s1 = squares[1];
+      const int s2 = squares[2];
+      const int adjust1 = s1 > s0;
+      const int adjust2 = (s2 > s0) + (s2 > s1);
+
+      if (off_diagonal(s0)) {
+        idx = (e.map_a1d1d4[s0] * 63 + (s1 - adjust1)) * 62 + s2 - adjust2;
+      } else if (off_diagonal(s1)) {
+        idx = (6 * 63 + rank_of(s0) * 28 + e.map_b1h1h7[s1]) * 62 + s2 -
+              adjust2;
+      } else if (off_diagonal(s2)) {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + rank_of(s0) * 7 * 28 +
+              (rank_of(s1) - adjust1) * 28 + e.map_b1h1h7[s2];
+      } else {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rank_of(s0) * 7 * 6 +
+              (rank_of(s1) - adjust1) * 6 + (rank_of(s2) - adjust2);
+      }
+    } else {
+      idx = e.map_kk[e.map_a1d1d4[squares[0]]][squares[1]];
+    }
+  }
+
+  idx *= d.group_idx[0];
+
+  // The other groups, each square counted among the ones left free by the
+  // groups before it
+  int group = d.group_len[0];
+  bool remaining_pawns = t.has_pawns && t.pawn_count[1];
+
+  for (int next = 1; d.group_len[next]; ++next) {
+    const int len = d.group_len[next];
+    std::stable_sort(squares.begin() + group, squares.begin() + group + len);
+
+    uint64_t n = 0;
+    for (int i = 0; i < len; ++i) {
+      const uint8_t sq = squares[group + i];
+      const int adjust = static_cast<int>(
+          std::count_if(squares.begin(), squares.begin() + group,
+                        [sq](const uint8_t s) { return sq > s; }));
+      n += e.binomial[i + 1][sq - adjust - 8 * remaining_pawns];
+    }
+
+    remaining_pawns = false;
+    idx += n * d.group_idx[next];
+    group += len;
+  }
+
+  return idx;
+}
+
+
+/**
+ * WDL or the DTZ value of the position in the opened table. DTZ tables
+ * only store one side to move, state is PROBE_CHANGE_STM for the other one.
+ */
+static int probe(table_t& t,
+                 const board_t& board,
+                 const wdl_t wdl,
+                 int& state)
+{
+  int stm = 0;
+  int file = 0;
+  const uint64_t idx = encode(t, board, stm, file);
+  const pairs_data_t& d = t.get(stm, file);
+
+  if (t.dtz && (d.flags & FLAG_STM) != stm &&
+      (t.key != t.key2 || t.has_pawns)) {
+    state = PROBE_CHANGE_STM;
+    return 0;
+  }
+
+  return map_score(t, file, decompress_pairs(d, idx), wdl);
+}
+
+
+/*******************************************************************************
+ * Tablebases
+ ******************************************************************************/
+tablebases_t::tablebases_t() = default;
+tablebases_t::~tablebases_t() = default;
+
+
+void tablebases_t::add_file(const std::string& directory,
+                            const std::string& file)
+{
+  const size_t dot = file.find('.');
+  if (dot == std::string::npos) { return; }
+
+  const std::string suffix = file.substr(dot);
+  const bool dtz = suffix == DTZ_SUFFIX;
+  if (!dtz && suffix != WDL_SUFFIX) { return; }
+
+  auto table = std::make_unique<table_t>();
+  if (!parse_name(file.substr(0, dot), *table)) { return; }
+
+  std::unordered_map<uint64_t, table_t*>& tables = dtz ? _dtz : _wdl;
+
+  // The first directory listed wins
+  if (tables.count(table->key)) { return; }
+
+  table->path = directory + "/" + file;
+  table->dtz = dtz;
+  tables[table->key] = table.get();
+  tables[table->key2] = table.get();
+
+  if (!dtz) { _max_pieces = std::max(_max_pieces, table->piece_count); }
+
+  _tables.push_back(std::move(table));
+}
+
+
+size_t tablebases_t::init(const std::string& paths)
+{
+  _tables.clear();
+  _wdl.clear();
+  _dtz.clear();
+  _max_pieces = 0;
+
+  if (paths.empty() || paths == "<empty>") { return 0; }
+
+  size_t begin = 0;
+  while (begin <= paths.size()) {
+    size_t end = paths.find(PATH_SEPARATOR, begin);
+    if (end == std::string::npos) { end = paths.size(); }
+
+    const std::string directory = paths.substr(begin, end - begin);
+    begin = end + 1;
+
+    std::error_code ec;
+    for (const auto& I : std::filesystem::directory_iterator(directory, ec)) {
+      if (I.is_regular_file(ec)) {
+        add_file(directory, I.path().filename().string());
+      }
+    }
+  }
+
+  size_t count = 0;
+  for (const auto& I : _tables) {
+    if (!I->dtz) { ++count; }
+  }
+
+  return count;
+}
+
+
+table_t* tablebases_t::find(
+    const std::unordered_map<uint64_t, table_t*>& tables,
+    const board_t& board)
+{
+  const auto it = tables.find(material_key(board));
+  return it == tables.end() ? nullptr : it->second;
+}
+
+
+/**
+ * Map the table the first time it is used. Only the opening is locked, once
+ * ready a table never changes.
+ */
+bool tablebases_t::open(table_t& table)
+{
+  if (table.ready.load(std::memory_order_acquire)) { return table.usable; }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (table.ready.load(std::memory_order_relaxed)) { return table.usable; }
+
+  try {
+    table.file.open(table.path);
+    table.file.advise_random();
+
+    const std::array<uint8_t, 4>& magic = table.dtz ? DTZ_MAGIC : WDL_MAGIC;
+    table.usable = table.file.size() >= magic.size() &&
+                   std::equal(magic.begin(), magic.end(),
+                              reinterpret_cast<const uint8_t*>(
+                                  table.file.data())) &&
+                   parse_table(table);
+  } catch (const input_exception& e) {
+    table.usable = false;
+  }
+
+  table.ready.store(true, std::memory_order_release);
+  return table.usable;
+}
+
+
+int tablebases_t::probe_table(board_t& board,
+                              const bool dtz,
+                              const wdl_t wdl,
+                              int& state)
+{
+  // KvK, the only material without a table
+  if (popcount(board.occupied_bb()) == 2) {
+    return dtz ? 0 : static_cast<int>(wdl_t::DRAW);
+  }
+
+  table_t* table = find(dtz ? _dtz : _wdl, board);
+  if (!table || !open(*table)) {
+    state = PROBE_FAIL;
+    return 0;
+  }
+
+  return probe(*table, board, wdl, state);
+}
+
+
+/**
+ * WDL of the position, trying the captures (and the pawn moves if zeroing)
+ * first: the tables don't know en passant and may store anything for a
+ * position whose best move is one of them. state is PROBE_ZEROING when the
+ * best move is such a move.
+ */
+wdl_t tablebases_t::search_wdl(board_t& board, int& state, const bool zeroing)
+{
+  move_list_t moves;
+  board.generate_legal_moves(moves);
+
+  int best = static_cast<int>(wdl_t::LOSS);
+  size_t count = 0;
+
+  for (const move_t& m : moves) {
+    const bool pawn = piece_type(board.piece_at(m.from)) == PAWN;
+    if (!m.is_capture() && (!zeroing || !pawn)) { continue; }
+
+    ++count;
+
+    board.make_move(m);
+    const int value = -static_cast<int>(search_wdl(board, state, false));
+    board.unmake_move();
+
+    if (state == PROBE_FAIL) { return wdl_t::DRAW; }
+
+    if (value > best) {
+      best = value;
+      if (value >= static_cast<int>(wdl_t::WIN)) {
+        state = PROBE_ZEROING;
+        return wdl_t::WIN;
+      }
+    }
+  }
+
+  // All the moves were tried, the table value is not needed
+  const bool all_tried = count && count == moves.size();
+
+  int value = best;
+  if (!all_tried) {
+    value = probe_table(board, false, wdl_t::DRAW, state);
+    if (state == PROBE_FAIL) { return wdl_t::DRAW; }
+  }
+
+  if (best >= value) {
+    state = best > static_cast<int>(wdl_t::DRAW) || all_tried ? PROBE_ZEROING
+                                                               : PROBE_OK;
+    return static_cast<wdl_t>(best);
+  }
+
+  state = PROBE_OK;
+  return static_cast<wdl_t>(value);
+}
+
+
+int tablebases_t::search_dtz(board_t& board, int& state)
+{
+  state = PROBE_OK;
+  const wdl_t wdl = search_wdl(board, state, true);
+
+  // Draws are not stored
+  if (state == PROBE_FAIL || wdl == wdl_t::DRAW) { return 0; }
+  if (state == PROBE_ZEROING) { return dtz_before_zeroing(wdl); }
+
+  int dtz = probe_table(board, true, wdl, state);
+  if (state == PROBE_FAIL) { return 0; }
+
+  if (state != PROBE_CHANGE_STM) {
+    const bool fifty = wdl == wdl_t::BLESSED_LOSS || wdl == wdl_t::CURSED_WIN;
+    return (dtz + 100 * fifty) * sign_of(static_cast<int>(wdl));
+  }
+
+  // Stored for the other side: one ply search for the best DTZ
+  const int wdl_sign = sign_of(static_cast<int>(wdl));
+  int min_dtz = NO_DTZ;
+
+  move_list_t moves;
+  board.generate_legal_moves(moves);
+
+  for (const move_t& m : moves) {
+    const bool zeroing =
+        m.is_capture() || piece_type(board.piece_at(m.from)) == PAWN;
+
+    board.make_move(m);
+
+    // The DTZ before a zeroing move, with the sign of the result after it
+    dtz = zeroing ? -dtz_before_zeroing(search_wdl(board, state, false))
+                  : -search_dtz(board, state);
+
+    if (dtz == 1 && board.in_check()) {
+      move_list_t replies;
+      board.generate_legal_moves(replies);
+      if (replies.empty()) { min_dtz = 1; }
+    }
+
+    if (!zeroing) { dtz += sign_of(dtz); }
+    if (dtz < min_dtz && sign_of(dtz) == wdl_sign) { min_dtz = dtz; }
+
+    board.unmake_move();
+
+    if (state == PROBE_FAIL) { return 0; }
+  }
+
+  // No legal move: mated
+  return min_dtz == NO_DTZ ? -1 : min_dtz;
+}
+
+
+/**
+ * The tables don't have the positions with castling rights
+ */
+static inline bool probeable(const board_t& board, const int max_pieces)
+{
+  return !board.available_castling() &&
+         popcount(board.occupied_bb()) <= max_pieces;
+}
+
+
+bool tablebases_t::probe_wdl(board_t& board, wdl_t& wdl)
+{
+  if (!probeable(board, _max_pieces)) { return false; }
+
+  int state = PROBE_OK;
+  wdl = search_wdl(board, state, false);
+  return state != PROBE_FAIL;
+}
+
+
+bool tablebases_t::probe_dtz(board_t& board, int& dtz)
+{
+  if (!probeable(board, _max_pieces)) { return false; }
+
+  int state = PROBE_OK;
+  dtz = search_dtz(board, state);
+  return state != PROBE_FAIL;
+}
+
+
+bool tablebases_t::filter_root_moves(board_t& board, move_list_t& moves)
+{
+  if (moves.empty() || !probeable(board, _max_pieces)) { return false; }
+
+  static constexpr int MAX_DTZ = 1 << 18;
+  std::array<int, MAX_MOVES> ranks;
+  int state = PROBE_OK;
+
+  // By DTZ: the fastest win, or the slowest loss
+  for (size_t i = 0; i < moves.size() && state != PROBE_FAIL; ++i) {
+    board.make_move(moves[i]);
+
+    // A repetition one ply from the root already happened in the game
+    int dtz = 0;
+    if (board.halfmove_clock() == 0) {
+      dtz = dtz_before_zeroing(negate(search_wdl(board, state, false)));
+    } else if (!board.is_draw()) {
+      dtz = -search_dtz(board, state);
+      dtz += sign_of(dtz);
+    }
+
+    // Mate is the fastest win of all
+    if (dtz == 2 && board.in_check()) {
+      move_list_t replies;
+      board.generate_legal_moves(replies);
+      if (replies.empty()) { dtz = 1; }
+    }
+
+    board.unmake_move();
+
+    ranks[i] = dtz > 0 ? MAX_DTZ - dtz : dtz < 0 ? -MAX_DTZ - dtz : 0;
+  }
+
+  // Or by WDL only, a draw by repetition is still a draw
+  if (state == PROBE_FAIL) {
+    for (size_t i = 0; i < moves.size(); ++i) {
+      board.make_move(moves[i]);
+
+      state = PROBE_OK;
+      const wdl_t wdl = board.is_draw()
+                            ? wdl_t::DRAW
+                            : negate(search_wdl(board, state, false));
+
+      board.unmake_move();
+
+      if (state == PROBE_FAIL) { return false; }
+
+      ranks[i] = static_cast<int>(wdl);
+    }
+  }
+
+  const int best = *std::max_element(ranks.begin(),
+                                     ranks.begin() + moves.size());
+
+  move_list_t kept;
+  for (size_t i = 0; i < moves.size(); ++i) {
+    if (ranks[i] == best) { kept.push_back(moves[i]); }
+  }
+  moves = kept;
+
+  return true;
+}
+
+}  // namespace syzygy
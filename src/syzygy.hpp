@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "board.hpp"
+#include "move.hpp"
+
+
+/*******************************************************************************
+ * Syzygy endgame tablebases
+ *
+ * Up to 7 pieces. Two kinds of files per material, named after it with the
+ * stronger side first, KQvKR.rtbw for instance:
+ *
+ *  rtbw  win/draw/loss of every position, with the fifty moves rule
+ *  rtbz  distance to the next capture or pawn move (DTZ) along a best line,
+ *        used at the root to pick the moves that keep the result
+ *
+ * init() only lists the files. A table is memory mapped the first time a
+ * position needs it and then shared read-only by every search thread, the
+ * probes never lock once the table is open. Positions with castling rights
+ * are not in the tables and can't be probed.
+ ******************************************************************************/
+namespace syzygy {
+
+static constexpr int MAX_PIECES = 7;
+
+
+enum class wdl_t : int8_t
+{
+  LOSS = -2,
+  BLESSED_LOSS = -1,  // Lost, but drawn by the fifty moves rule
+  DRAW = 0,
+  CURSED_WIN = 1,  // Won, but drawn by the fifty moves rule
+  WIN = 2
+};
+
+
+struct table_t;
+
+
+class tablebases_t
+{
+private:
+  std::vector<std::unique_ptr<table_t>> _tables;
+  std::unordered_map<uint64_t, table_t*> _wdl;
+  std::unordered_map<uint64_t, table_t*> _dtz;
+  std::mutex _mutex;  // Held only while a table is being opened
+  int _max_pieces = 0;
+
+  void add_file(const std::string& directory, const std::string& file);
+  table_t* find(const std::unordered_map<uint64_t, table_t*>& tables,
+                const board_t& board);
+  bool open(table_t& table);
+
+  int probe_table(board_t& board, const bool dtz, const wdl_t wdl, int& state);
+  wdl_t search_wdl(board_t& board, int& state, const bool zeroing);
+  int search_dtz(board_t& board, int& state);
+
+public:
+  tablebases_t();
+  ~tablebases_t();
+
+  tablebases_t(const tablebases_t&) = delete;
+  tablebases_t& operator=(const tablebases_t&) = delete;
+
+  /**
+   * Look for the tables in the directories of paths, separated by ':' (';'
+   * on Windows). Replaces the tables found before, an empty string or
+   * <empty> unloads them. Returns the number of WDL tables found. Not thread
+   * safe: no search can be running.
+   */
+  size_t init(const std::string& paths);
+
+  /**
+   * Most pieces on the board of any table found, 0 if none
+   */
+  inline int max_pieces() const { return _max_pieces; }
+
+  /**
+   * Result for the side to move. False if the table is missing or the
+   * position can't be probed.
+   */
+  bool probe_wdl(board_t& board, wdl_t& wdl);
+
+  /**
+   * Distance to zero in plies for the side to move: positive when winning,
+   * negative when losing, 0 for a draw. 100 more for the cursed wins and
+   * blessed losses. False if a table is missing.
+   */
+  bool probe_dtz(board_t& board, int& dtz);
+
+  /**
+   * Keep only the legal moves that preserve the result of the position:
+   * when winning the ones converting fastest, when losing the ones resisting
+   * longest, by DTZ or by WDL alone if a DTZ table is missing. False,
+   * leaving the moves unchanged, if the position can't be probed.
+   */
+  bool filter_root_moves(board_t& board, move_list_t& moves);
+};
+
+}  // namespace syzygy
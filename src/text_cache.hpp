@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <pixello.hpp>
+#include <string>
+#include <unordered_map>
+
+
+/**
+ * LRU cache of rendered text textures keyed on (text, color).
+ *
+ * Rasterizing a string and uploading it is the most expensive thing a frame
+ * can do, so the textures are kept around and the least recently used one is
+ * dropped when the cache is full.
+ */
+class text_cache_t
+{
+private:
+  struct entry_t
+  {
+    std::string key;
+    texture_t texture;
+  };
+
+  size_t _capacity;
+  std::list<entry_t> _entries;  // Most recently used first
+  std::unordered_map<std::string, std::list<entry_t>::iterator> _index;
+  uint64_t _hits = 0;
+  uint64_t _misses = 0;
+
+  static inline std::string make_key(const std::string& text,
+                                     const uint32_t color)
+  {
+    std::string key = text;
+    key.push_back('\0');
+    key.append(reinterpret_cast<const char*>(&color), sizeof(color));
+    return key;
+  }
+
+public:
+  explicit text_cache_t(const size_t capacity = 64) : _capacity(capacity) {}
+
+  /**
+   * The texture of the text, made with create(text, pixel_t) on a miss
+   */
+  template <typename F>
+  const texture_t& get(const std::string& text,
+                       const uint32_t color,
+                       F&& create)
+  {
+    const std::string key = make_key(text, color);
+
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      ++_hits;
+      _entries.splice(_entries.begin(), _entries, it->second);
+      return it->second->texture;
+    }
+
+    ++_misses;
+    _entries.push_front({key, create(text, pixel_t{color})});
+    _index[key] = _entries.begin();
+
+    if (_entries.size() > _capacity) {
+      _index.erase(_entries.back().key);
+      _entries.pop_back();
+    }
+
+    return _entries.front().texture;
+  }
+
+  inline void clear()
+  {
+    _entries.clear();
+    _index.clear();
+  }
+
+  inline size_t size() const { return _entries.size(); }
+  inline uint64_t hits() const { return _hits; }
+  inline uint64_t misses() const { return _misses; }
+};
@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "mapped_file.hpp"
+#include "perft.hpp"
+#include "search.hpp"
+#include "tt.hpp"
+
+
+/**
+ * Offline batch search of EPD/FEN files
+ *
+ *   chesso-batch <input> <output> [--depth n | --nodes n] [--threads n]
+ *                [--hash mb]
+ *   chesso-batch --suite
+ *
+ * The input is memory mapped and cut in line aligned chunks. Every worker
+ * owns a range of chunks and steals from the others once its range is over.
+ * Every position gets a fresh single threaded search, so the results don't
+ * depend on the number of workers, and the output keeps the input order:
+ *
+ *   <position>\t<best move>\t<cp n | mate n>\t<depth>\t<nodes>
+ *   <line>\terror\t<message>
+ *
+ * Empty lines and lines starting with # are skipped.
+ *
+ * The suite searches the perft positions with 1 and with several workers and
+ * checks the outputs are the same.
+ */
+
+
+static constexpr size_t CHUNK_BYTES = 16 * 1024;
+static constexpr size_t MIN_CHUNK_BYTES = 256;
+static constexpr size_t DEFAULT_BATCH_HASH_MB = 2;
+static constexpr int SUITE_DEPTH = 6;
+static constexpr size_t SUITE_REPEAT = 4;
+static constexpr size_t SUITE_THREADS = 3;
+
+
+struct options_t
+{
+  std::string input;
+  std::string output;
+  search_limits_t limits;
+  size_t threads = 1;
+  size_t hash_mb = DEFAULT_BATCH_HASH_MB;
+};
+
+
+struct chunk_t
+{
+  std::string_view text;
+  std::string output;
+  size_t positions = 0;
+  bool done = false;
+};
+
+
+/**
+ * Range of chunk indexes [front, back) packed in one word. The owner takes
+ * from the front, the thieves from the back, both with a single CAS so a
+ * chunk can't be handed out twice.
+ */
+struct alignas(64) work_range_t
+{
+  std::atomic<uint64_t> range{0};
+
+  inline void assign(const uint32_t front, const uint32_t back)
+  {
+    range.store((static_cast<uint64_t>(front) << 32) | back);
+  }
+
+  inline bool pop_front(uint32_t& chunk)
+  {
+    uint64_t r = range.load(std::memory_order_relaxed);
+
+    for (;;) {
+      const uint32_t front = r >> 32;
+      const uint32_t back = r & 0xFFFFFFFF;
+      if (front >= back) { return false; }
+
+      const uint64_t next = (static_cast<uint64_t>(front + 1) << 32) | back;
+      if (range.compare_exchange_weak(r, next, std::memory_order_acq_rel)) {
+        chunk = front;
+        return true;
+      }
+    }
+  }
+
+  inline bool steal_back(uint32_t& chunk)
+  {
+    uint64_t r = range.load(std::memory_order_relaxed);
+
+    for (;;) {
+      const uint32_t front = r >> 32;
+      const uint32_t back = r & 0xFFFFFFFF;
+      if (front >= back) { return false; }
+
+      const uint64_t next = (static_cast<uint64_t>(front) << 32) | (back - 1);
+      if (range.compare_exchange_weak(r, next, std::memory_order_acq_rel)) {
+        chunk = back - 1;
+        return true;
+      }
+    }
+  }
+};
+
+
+class batch_t
+{
+private:
+  const options_t& _options;
+  std::vector<chunk_t> _chunks;
+  std::vector<work_range_t> _ranges;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+
+  void split(const std::string_view text);
+  void worker(const size_t id);
+  void process(chunk_t& chunk,
+               board_t& board,
+               transposition_table_t& tt,
+               search_t& search);
+
+public:
+  explicit batch_t(const options_t& options) : _options(options) {}
+
+  /**
+   * Search every position of the input, return the number of positions.
+   * Throws input_exception if the output can't be written.
+   */
+  size_t run();
+};
+
+
+void batch_t::split(const std::string_view text)
+{
+  // Small inputs still get a few chunks per worker to balance
+  const size_t chunk_bytes = std::clamp<size_t>(
+      text.size() / (_options.threads * 8), MIN_CHUNK_BYTES, CHUNK_BYTES);
+  size_t begin = 0;
+
+  while (begin < text.size()) {
+    size_t end = std::min(begin + chunk_bytes, text.size());
+
+    // Extend the chunk to the end of its last line
+    const size_t eol = text.find('\n', end == 0 ? 0 : end - 1);
+    end = eol == std::string_view::npos ? text.size() : eol + 1;
+
+    chunk_t chunk;
+    chunk.text = text.substr(begin, end - begin);
+    _chunks.push_back(std::move(chunk));
+    begin = end;
+  }
+}
+
+
+static std::string_view trim(std::string_view s)
+{
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) {
+    s.remove_prefix(1);
+  }
+
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+    s.remove_suffix(1);
+  }
+
+  return s;
+}
+
+
+void batch_t::process(chunk_t& chunk,
+                      board_t& board,
+                      transposition_table_t& tt,
+                      search_t& search)
+{
+  std::string_view text = chunk.text;
+  search_info_t last;
+  move_t best = NULL_MOVE;
+
+  search.on_info = [&last](const search_info_t& info) { last = info; };
+  search.on_bestmove = [&best](const move_t& m, const move_t&) { best = m; };
+
+  while (!text.empty()) {
+    const size_t eol = text.find('\n');
+    const std::string_view line = trim(text.substr(0, eol));
+    text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+    if (line.empty() || line.front() == '#') { continue; }
+
+    ++chunk.positions;
+
+    const fen_result_t res = board.parse(line, true);
+    if (!res) {
+      chunk.output.append(line);
+      chunk.output += "\terror\t";
+      chunk.output += fen_error_message(res, line);
+      chunk.output += '\n';
+      continue;
+    }
+
+    // A clean table and history for every position keep the results
+    // reproducible, whatever the worker searched before
+    tt.clear();
+    search.clear();
+    last = search_info_t();
+    best = NULL_MOVE;
+    search.search(board, _options.limits);
+
+    chunk.output.append(trim(line.substr(0, res.position)));
+    chunk.output += '\t';
+    chunk.output += to_string(best);
+    chunk.output += last.is_mate() ? "\tmate " : "\tcp ";
+    chunk.output +=
+        std::to_string(last.is_mate() ? last.mate_in() : last.score);
+    chunk.output += '\t';
+    chunk.output += std::to_string(last.depth);
+    chunk.output += '\t';
+    chunk.output += std::to_string(last.nodes);
+    chunk.output += '\n';
+  }
+}
+
+
+void batch_t::worker(const size_t id)
+{
+  board_t board;
+  transposition_table_t tt(_options.hash_mb);
+  search_t search(tt);
+  search.set_threads(1);
+
+  const size_t workers = _ranges.size();
+  uint32_t index = 0;
+
+  for (;;) {
+    bool found = _ranges[id].pop_front(index);
+
+    // Our range is over, help the others starting from the next worker
+    for (size_t i = 1; !found && i < workers; ++i) {
+      found = _ranges[(id + i) % workers].steal_back(index);
+    }
+
+    if (!found) { return; }
+
+    chunk_t& chunk = _chunks[index];
+    process(chunk, board, tt, search);
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      chunk.done = true;
+    }
+    _cv.notify_all();
+  }
+}
+
+
+size_t batch_t::run()
+{
+  mapped_file_t input(_options.input);
+  input.advise_sequential();
+
+  FILE* output = std::fopen(_options.output.c_str(), "wb");
+  if (output == nullptr) {
+    throw input_exception("Can't open " + _options.output);
+  }
+
+  split(input.view());
+
+  // Contiguous ranges of chunks, one per worker
+  const size_t workers =
+      std::max<size_t>(1, std::min(_options.threads, _chunks.size()));
+  const size_t count = _chunks.size();
+  _ranges = std::vector<work_range_t>(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    _ranges[i].assign(static_cast<uint32_t>(count * i / workers),
+                      static_cast<uint32_t>(count * (i + 1) / workers));
+  }
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; ++i) {
+    threads.emplace_back(&batch_t::worker, this, i);
+  }
+
+  // Write the chunks in input order as soon as they are ready. After a write
+  // error the workers still run to the end, they can't be joined otherwise.
+  size_t positions = 0;
+  bool written = true;
+  for (chunk_t& chunk : _chunks) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [&chunk] { return chunk.done; });
+    }
+
+    written = written && std::fwrite(chunk.output.data(), 1,
+                                     chunk.output.size(),
+                                     output) == chunk.output.size();
+    positions += chunk.positions;
+    std::string().swap(chunk.output);
+  }
+
+  for (auto& I : threads) {
+    I.join();
+  }
+
+  written = std::fclose(output) == 0 && written;
+  if (!written) { throw input_exception("Can't write " + _options.output); }
+
+  return positions;
+}
+
+
+static std::string read_file(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+
+/**
+ * Every position several times, so each worker searches a few of them after
+ * something else
+ */
+static bool run_suite()
+{
+  const std::filesystem::path dir = std::filesystem::temp_directory_path();
+  const std::string input = (dir / "chesso_batch_suite.epd").string();
+
+  {
+    std::ofstream out(input, std::ios::trunc);
+    for (size_t i = 0; i < SUITE_REPEAT; ++i) {
+      for (const perft_position_t& p : PERFT_SUITE) {
+        out << p.fen << '\n';
+      }
+    }
+  }
+
+  std::string results[2];
+  const size_t threads[2] = {1, SUITE_THREADS};
+
+  for (size_t i = 0; i < 2; ++i) {
+    options_t options;
+    options.input = input;
+    options.output =
+        (dir / ("chesso_batch_suite_" + std::to_string(i) + ".out")).string();
+    options.limits.depth = SUITE_DEPTH;
+    options.threads = threads[i];
+
+    batch_t batch(options);
+    batch.run();
+
+    results[i] = read_file(options.output);
+    std::filesystem::remove(options.output);
+  }
+
+  std::filesystem::remove(input);
+
+  if (results[0].empty() || results[0] != results[1]) {
+    LOG_E << "[FAIL] " << SUITE_THREADS << " workers don't give the results "
+          << "of 1" << END_E;
+    return false;
+  }
+
+  LOG_S << "[OK] same results with 1 and " << SUITE_THREADS << " workers"
+        << END_S;
+  return true;
+}
+
+
+static bool parse_arguments(int argc, char** argv, options_t& options)
+{
+  std::vector<std::string> positional;
+  options.limits.depth = 8;
+  options.threads = std::max(1U, std::thread::hardware_concurrency());
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+
+    if (arg == "--depth" && i + 1 < argc) {
+      options.limits.depth = std::clamp(std::atoi(argv[++i]), 1, MAX_PLY - 1);
+    } else if (arg == "--nodes" && i + 1 < argc) {
+      options.limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+      options.limits.depth = MAX_PLY - 1;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--hash" && i + 1 < argc) {
+      options.hash_mb = std::max(1, std::atoi(argv[++i]));
+    } else if (!arg.empty() && arg[0] != '-') {
+      positional.push_back(arg);
+    } else {
+      LOG_E << "Unknown argument " << arg << END_E;
+      return false;
+    }
+  }
+
+  if (positional.size() != 2) {
+    LOG_E << "Usage: chesso-batch <input> <output> [--depth n | --nodes n] "
+             "[--threads n] [--hash mb]"
+          << END_E;
+    return false;
+  }
+
+  options.input = positional[0];
+  options.output = positional[1];
+
+  return true;
+}
+
+
+int main(int argc, char** argv)
+{
+  if (argc == 2 && std::string(argv[1]) == "--suite") {
+    try {
+      return run_suite() ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const pixello_exception& e) {
+      LOG_E << e.what() << END_E;
+      return EXIT_FAILURE;
+    }
+  }
+
+  options_t options;
+  if (!parse_arguments(argc, argv, options)) { return EXIT_FAILURE; }
+
+  try {
+    const auto start = std::chrono::steady_clock::now();
+
+    batch_t batch(options);
+    const size_t positions = batch.run();
+
+    const auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    LOG_I << "Positions: " << positions << " Threads: " << options.threads
+          << " Time: " << seconds << " s Positions/s: "
+          << (seconds > 0.0 ? positions / seconds : positions) << END_I;
+  } catch (const pixello_exception& e) {
+    LOG_E << e.what() << END_E;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
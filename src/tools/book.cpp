@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "polyglot.hpp"
+
+
+/**
+ * Polyglot book browser
+ *
+ *   chesso-book --suite
+ *   chesso-book <book.bin> [--fen "<FEN>"]
+ *
+ * The suite checks the Polyglot keys of the reference positions of the
+ * format description. Otherwise the book moves of the position (the start
+ * position by default) are listed with their weights.
+ */
+
+
+struct key_position_t
+{
+  const char* fen;
+  uint64_t key;
+};
+
+
+static const key_position_t KEY_SUITE[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     0x463B96181691FC9C},
+    {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+     0x823C9B50FD114196},
+    {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2",
+     0x0756B94461C50FB0},
+    {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2",
+     0x662FAFB965DB29D4},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+     0x22A48B5A8E47FF78},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3",
+     0x652A607CA3F242C1},
+    {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4",
+     0x00FDD303C946BDD9},
+    {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3",
+     0x3C8123EA7B067637},
+    {"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4",
+     0x5C3F9B829B279560}};
+
+
+static std::string hex(const uint64_t v)
+{
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016llx",
+                static_cast<unsigned long long>(v));
+  return buffer;
+}
+
+
+static bool run_suite()
+{
+  bool ok = true;
+  board_t board;
+
+  for (const key_position_t& p : KEY_SUITE) {
+    board.load(p.fen);
+    const uint64_t key = polyglot::key(board);
+
+    if (key == p.key) {
+      LOG_S << "[OK] " << hex(key) << " " << p.fen << END_S;
+    } else {
+      LOG_E << "[FAIL] " << p.fen << " expected " << hex(p.key) << " got "
+            << hex(key) << END_E;
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+
+int main(int argc, char** argv)
+{
+  if (argc == 2 && std::string(argv[1]) == "--suite") {
+    return run_suite() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (argc != 2 && !(argc == 4 && std::string(argv[2]) == "--fen")) {
+    LOG_E << "Usage: chesso-book --suite | <book.bin> [--fen \"<FEN>\"]"
+          << END_E;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    polyglot::book_t book;
+    book.open(argv[1]);
+
+    board_t board;
+    if (argc == 4) { board.load(argv[3]); }
+
+    std::vector<polyglot::book_move_t> moves;
+    book.moves(board, moves);
+
+    LOG_I << "Key " << hex(polyglot::key(board)) << ", " << moves.size()
+          << " book moves" << END_I;
+    for (const polyglot::book_move_t& I : moves) {
+      LOG_I << to_string(I.move) << " " << I.weight << END_I;
+    }
+  } catch (const input_exception& e) {
+    LOG_E << e.what() << END_E;
+    return EXIT_FAILURE;
+  } catch (const FAN_exception& e) {
+    LOG_E << e.what() << END_E;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "board.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "mapped_file.hpp"
+#include "packed.hpp"
+
+
+/**
+ * Convert between FEN/EPD text files and packed position files
+ *
+ *   chesso-pack <input.epd> <output.cpk> [--no-index]
+ *   chesso-pack --unpack <input.cpk> <output.fen>
+ *
+ * Packing reads one position per line, EPD operations after the position are
+ * dropped. Lines that are empty, start with # or don't parse are skipped.
+ */
+
+
+static double seconds_since(const std::chrono::steady_clock::time_point& t)
+{
+  const auto now = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(now - t).count();
+}
+
+
+static void pack(const std::string& input,
+                 const std::string& output,
+                 const bool with_index)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  mapped_file_t file(input);
+  file.advise_sequential();
+
+  packed_writer_t writer(output, with_index);
+  board_t board;
+  uint64_t skipped = 0;
+
+  std::string_view text = file.view();
+  while (!text.empty()) {
+    const size_t eol = text.find('\n');
+    const std::string_view line = text.substr(0, eol);
+    text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+    if (line.find_first_not_of(" \t\r") == std::string_view::npos ||
+        line.front() == '#') {
+      continue;
+    }
+
+    if (!board.parse(line, true)) {
+      ++skipped;
+      continue;
+    }
+
+    writer.append(board);
+  }
+
+  const uint64_t count = writer.size();
+  writer.close();
+
+  LOG_I << "Packed " << count << " positions (" << skipped << " skipped) in "
+        << seconds_since(start) << " s" << END_I;
+}
+
+
+static void unpack(const std::string& input, const std::string& output)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  packed_reader_t reader(input);
+  board_t board;
+  uint64_t invalid = 0;
+
+  std::FILE* file = std::fopen(output.c_str(), "wb");
+  if (file == nullptr) { throw input_exception("Can't open " + output); }
+
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    if (board.unpack(reader[i]) != fen_error_t::OK) {
+      ++invalid;
+      continue;
+    }
+
+    const std::string fen = board.fen();
+    std::fwrite(fen.data(), 1, fen.size(), file);
+    std::fputc('\n', file);
+  }
+
+  std::fclose(file);
+
+  LOG_I << "Unpacked " << reader.size() - invalid << " positions (" << invalid
+        << " invalid) in " << seconds_since(start) << " s" << END_I;
+}
+
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> positional;
+  bool with_index = true;
+  bool unpacking = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+
+    if (arg == "--no-index") {
+      with_index = false;
+    } else if (arg == "--unpack") {
+      unpacking = true;
+    } else if (!arg.empty() && arg[0] != '-') {
+      positional.push_back(arg);
+    } else {
+      LOG_E << "Unknown argument " << arg << END_E;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (positional.size() != 2) {
+    LOG_E << "Usage: chesso-pack <input.epd> <output.cpk> [--no-index]\n"
+             "       chesso-pack --unpack <input.cpk> <output.fen>"
+          << END_E;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    if (unpacking) {
+      unpack(positional[0], positional[1]);
+    } else {
+      pack(positional[0], positional[1], with_index);
+    }
+  } catch (const pixello_exception& e) {
+    LOG_E << e.what() << END_E;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
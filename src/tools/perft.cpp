@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "board.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "perft.hpp"
+
+
+/**
+ * Headless perft runner
+ *
+ *   chesso_perft [--suite [name]]
+ *   chesso_perft --fen "<FEN>" --depth <n> [--divide]
+ *
+ * Without arguments it runs the whole reference suite. Returns a non zero exit
+ * code if any node count doesn't match.
+ */
+
+
+static double run(board_t& board,
+                  const int depth,
+                  const bool divide,
+                  uint64_t& nodes)
+{
+  const auto start = std::chrono::steady_clock::now();
+  nodes = divide ? perft_divide(board, depth) : perft(board, depth);
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double>(end - start).count();
+}
+
+
+static void print_result(const uint64_t nodes, const double seconds)
+{
+  const uint64_t nps =
+      seconds > 0.0 ? static_cast<uint64_t>(nodes / seconds) : nodes;
+
+  LOG_I << "Nodes: " << nodes << " Time: " << seconds * 1000.0
+        << " ms NPS: " << nps << END_I;
+}
+
+
+static bool run_suite(const char* name)
+{
+  bool ok = true;
+  bool found = false;
+  uint64_t total_nodes = 0;
+  double total_time = 0.0;
+  board_t board;
+
+  for (const perft_position_t& p : PERFT_SUITE) {
+    if (name != nullptr && std::strcmp(name, p.name) != 0) { continue; }
+    found = true;
+
+    board.load(p.fen);
+
+    uint64_t nodes = 0;
+    const double seconds = run(board, p.depth, false, nodes);
+    total_nodes += nodes;
+    total_time += seconds;
+
+    if (nodes == p.nodes) {
+      LOG_S << "[OK] " << p.name << " depth " << p.depth << END_S;
+    } else {
+      LOG_E << "[FAIL] " << p.name << " depth " << p.depth << " expected "
+            << p.nodes << " got " << nodes << END_E;
+      ok = false;
+    }
+    print_result(nodes, seconds);
+  }
+
+  if (!found) {
+    LOG_E << "Unknown perft position " << name << END_E;
+    return false;
+  }
+
+  LOG_I << "Total" << END_I;
+  print_result(total_nodes, total_time);
+
+  return ok;
+}
+
+
+int main(int argc, char** argv)
+{
+  std::string fen;
+  int depth = 0;
+  bool divide = false;
+  bool suite = argc == 1;
+  const char* suite_name = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+
+    if (arg == "--fen" && i + 1 < argc) {
+      fen = argv[++i];
+    } else if (arg == "--depth" && i + 1 < argc) {
+      depth = std::atoi(argv[++i]);
+    } else if (arg == "--divide") {
+      divide = true;
+    } else if (arg == "--suite") {
+      suite = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-') { suite_name = argv[++i]; }
+    } else {
+      LOG_E << "Unknown argument " << arg << END_E;
+      return EXIT_FAILURE;
+    }
+  }
+
+  try {
+    if (suite) { return run_suite(suite_name) ? EXIT_SUCCESS : EXIT_FAILURE; }
+
+    if (depth < 1) {
+      LOG_E << "Depth must be at least 1" << END_E;
+      return EXIT_FAILURE;
+    }
+
+    board_t board;
+    if (!fen.empty()) { board.load(fen); }
+
+    uint64_t nodes = 0;
+    const double seconds = run(board, depth, divide, nodes);
+    print_result(nodes, seconds);
+  } catch (const FAN_exception& e) {
+    LOG_E << e.what() << END_E;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
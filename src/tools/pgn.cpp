@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "board.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "mapped_file.hpp"
+#include "pgn.hpp"
+
+
+/**
+ * Replay every game of a PGN file and extract some statistics
+ *
+ *   chesso-pgn <file> [--threads n] [--opening-plies n] [--top n]
+ *
+ * The file is memory mapped and cut at the [Event tags, the pieces are
+ * replayed in parallel and the per thread statistics merged at the end:
+ * games, illegal games, positions, distinct positions (by Zobrist key) and
+ * the most played openings, counted by the position reached after the
+ * opening plies so transpositions count as the same opening.
+ */
+
+
+static constexpr size_t PGN_CHUNK_BYTES = 1024 * 1024;
+
+
+struct options_t
+{
+  std::string input;
+  size_t threads = 1;
+  int opening_plies = 8;
+  size_t top = 10;
+};
+
+
+struct opening_t
+{
+  uint64_t count = 0;
+  std::string moves;  // The moves of the first game reaching it
+};
+
+
+struct stats_t
+{
+  uint64_t games = 0;
+  uint64_t errors = 0;
+  uint64_t positions = 0;
+  std::unordered_set<uint64_t> keys;
+  std::unordered_map<uint64_t, opening_t> openings;
+
+  void merge(stats_t& o)
+  {
+    games += o.games;
+    errors += o.errors;
+    positions += o.positions;
+
+    if (keys.size() < o.keys.size()) { keys.swap(o.keys); }
+    keys.insert(o.keys.begin(), o.keys.end());
+
+    for (auto& [key, opening] : o.openings) {
+      opening_t& mine = openings[key];
+      if (mine.count == 0) { mine.moves = std::move(opening.moves); }
+      mine.count += opening.count;
+    }
+  }
+};
+
+
+/**
+ * Cut the text right before an [Event tag at the start of a line, so every
+ * piece holds whole games
+ */
+static std::vector<std::string_view> split_games(const std::string_view text)
+{
+  std::vector<std::string_view> res;
+  size_t begin = 0;
+
+  while (begin < text.size()) {
+    size_t end = text.find("\n[Event ", begin + PGN_CHUNK_BYTES);
+    end = end == std::string_view::npos ? text.size() : end + 1;
+
+    res.push_back(text.substr(begin, end - begin));
+    begin = end;
+  }
+
+  return res;
+}
+
+
+static void replay(const std::string_view text,
+                   const options_t& options,
+                   stats_t& stats)
+{
+  board_t board;
+  pgn_reader_t reader(text);
+  pgn_game_t game;
+
+  while (reader.next(game)) {
+    ++stats.games;
+
+    // The opening moves are views on the file until the opening is new
+    std::string_view first_move;
+    std::string_view last_move;
+    int ply = 0;
+
+    const pgn_replay_result_t res = pgn_replay(
+        board, game,
+        [&](const board_t& b, const move_t&, const std::string_view san) {
+          ++stats.positions;
+          stats.keys.insert(b.key());
+
+          ++ply;
+          if (first_move.empty()) { first_move = san; }
+          if (ply <= options.opening_plies) { last_move = san; }
+
+          if (ply == options.opening_plies) {
+            opening_t& o = stats.openings[b.key()];
+            if (o.count++ == 0) {
+              o.moves = std::string(
+                  first_move.data(),
+                  last_move.data() + last_move.size() - first_move.data());
+            }
+          }
+
+          return true;
+        });
+
+    if (!res) { ++stats.errors; }
+  }
+}
+
+
+static bool parse_arguments(int argc, char** argv, options_t& options)
+{
+  std::vector<std::string> positional;
+  options.threads = std::max(1U, std::thread::hardware_concurrency());
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+
+    if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--opening-plies" && i + 1 < argc) {
+      options.opening_plies = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--top" && i + 1 < argc) {
+      options.top = std::max(0, std::atoi(argv[++i]));
+    } else if (!arg.empty() && arg[0] != '-') {
+      positional.push_back(arg);
+    } else {
+      LOG_E << "Unknown argument " << arg << END_E;
+      return false;
+    }
+  }
+
+  if (positional.size() != 1) {
+    LOG_E << "Usage: chesso-pgn <file> [--threads n] [--opening-plies n] "
+             "[--top n]"
+          << END_E;
+    return false;
+  }
+
+  options.input = positional[0];
+
+  return true;
+}
+
+
+int main(int argc, char** argv)
+{
+  options_t options;
+  if (!parse_arguments(argc, argv, options)) { return EXIT_FAILURE; }
+
+  try {
+    const auto start = std::chrono::steady_clock::now();
+
+    mapped_file_t input(options.input);
+    input.advise_sequential();
+
+    const std::vector<std::string_view> pieces = split_games(input.view());
+    const size_t workers = std::max<size_t>(
+        1, std::min(options.threads, pieces.size()));
+
+    std::vector<stats_t> stats(workers);
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next{0};
+
+    for (size_t i = 0; i < workers; ++i) {
+      threads.emplace_back([&, i]() {
+        for (size_t p = next++; p < pieces.size(); p = next++) {
+          replay(pieces[p], options, stats[i]);
+        }
+      });
+    }
+
+    for (auto& I : threads) {
+      I.join();
+    }
+
+    for (size_t i = 1; i < workers; ++i) {
+      stats[0].merge(stats[i]);
+    }
+
+    const stats_t& total = stats[0];
+    const auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    LOG_I << "Games: " << total.games << " Errors: " << total.errors
+          << " Positions: " << total.positions
+          << " Distinct positions: " << total.keys.size() << END_I;
+    LOG_I << "Time: " << seconds << " s Games/s: "
+          << (seconds > 0.0 ? total.games / seconds : total.games) << END_I;
+
+    // Most played openings
+    std::vector<const opening_t*> openings;
+    for (const auto& I : total.openings) {
+      openings.push_back(&I.second);
+    }
+
+    const size_t top = std::min(options.top, openings.size());
+    std::partial_sort(openings.begin(), openings.begin() + top,
+                      openings.end(),
+                      [](const opening_t* a, const opening_t* b) {
+                        return a->count > b->count;
+                      });
+
+    for (size_t i = 0; i < top; ++i) {
+      LOG_I << openings[i]->count << "  " << openings[i]->moves << END_I;
+    }
+  } catch (const pixello_exception& e) {
+    LOG_E << e.what() << END_E;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
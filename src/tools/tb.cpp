@@ -0,0 +1,158 @@
+#include <cstdlib>
+#include <string>
+#include "board.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "syzygy.hpp"
+
+
+/**
+ * Syzygy tablebases checker
+ *
+ *   chesso-tb <paths> [--suite]
+ *   chesso-tb <paths> --fen "<FEN>"
+ *
+ * The suite needs the KPvK, KNvK, KBvK, KRvK and KQvK tables. Every position
+ * is probed for WDL and DTZ and every root move kept must preserve the
+ * result. Returns a non zero exit code if any of it doesn't match.
+ */
+
+
+struct tb_position_t
+{
+  const char* name;
+  const char* fen;
+  syzygy::wdl_t wdl;
+};
+
+
+static const tb_position_t TB_SUITE[] = {
+    {"kqk_white", "4k3/8/8/8/8/8/8/3QK3 w - - 0 1", syzygy::wdl_t::WIN},
+    {"kqk_black", "4k3/8/8/8/8/8/8/3QK3 b - - 0 1", syzygy::wdl_t::LOSS},
+    {"krk", "4k3/8/8/8/8/8/8/R3K3 w - - 0 1", syzygy::wdl_t::WIN},
+    {"krk_capture", "8/8/8/8/8/8/1k6/R3K3 b - - 0 1", syzygy::wdl_t::DRAW},
+    {"kbk", "4k3/8/8/8/8/8/8/2B1K3 w - - 0 1", syzygy::wdl_t::DRAW},
+    {"knk", "4k3/8/8/8/8/8/8/1N2K3 w - - 0 1", syzygy::wdl_t::DRAW},
+    {"kpk_promotion", "8/4P3/4K3/8/8/8/8/k7 w - - 0 1", syzygy::wdl_t::WIN},
+    {"kpk_unstoppable", "8/4P3/4K3/8/8/8/8/k7 b - - 0 1", syzygy::wdl_t::LOSS},
+    {"kpk_rook_pawn", "k7/8/8/8/8/8/P7/K7 w - - 0 1", syzygy::wdl_t::DRAW},
+    {"kpk_capture", "8/8/8/8/8/8/3kP3/7K b - - 0 1", syzygy::wdl_t::DRAW}};
+
+
+static int sign_of(const int v) { return (v > 0) - (v < 0); }
+
+
+static bool check(syzygy::tablebases_t& tb, const tb_position_t& p)
+{
+  board_t board;
+  board.load(p.fen);
+
+  syzygy::wdl_t wdl;
+  int dtz = 0;
+  if (!tb.probe_wdl(board, wdl) || !tb.probe_dtz(board, dtz)) {
+    LOG_E << "[FAIL] " << p.name << " missing table" << END_E;
+    return false;
+  }
+
+  if (wdl != p.wdl || sign_of(dtz) != sign_of(static_cast<int>(wdl))) {
+    LOG_E << "[FAIL] " << p.name << " expected wdl "
+          << static_cast<int>(p.wdl) << " got " << static_cast<int>(wdl)
+          << " dtz " << dtz << END_E;
+    return false;
+  }
+
+  move_list_t moves;
+  board.generate_legal_moves(moves);
+  if (!tb.filter_root_moves(board, moves) || moves.empty()) {
+    LOG_E << "[FAIL] " << p.name << " root moves not filtered" << END_E;
+    return false;
+  }
+
+  for (const move_t& m : moves) {
+    board.make_move(m);
+    syzygy::wdl_t after;
+    const bool ok = tb.probe_wdl(board, after) &&
+                    -static_cast<int>(after) == static_cast<int>(p.wdl);
+    board.unmake_move();
+
+    if (!ok) {
+      LOG_E << "[FAIL] " << p.name << " " << to_string(m)
+            << " changes the result" << END_E;
+      return false;
+    }
+  }
+
+  LOG_S << "[OK] " << p.name << " wdl " << static_cast<int>(wdl) << " dtz "
+        << dtz << " " << moves.size() << " root moves" << END_S;
+  return true;
+}
+
+
+static void print_probe(syzygy::tablebases_t& tb, const std::string& fen)
+{
+  board_t board;
+  board.load(fen);
+
+  syzygy::wdl_t wdl;
+  int dtz = 0;
+  if (!tb.probe_wdl(board, wdl)) {
+    LOG_W << "Position not in the tablebases" << END_W;
+    return;
+  }
+
+  LOG_I << "WDL: " << static_cast<int>(wdl) << END_I;
+  if (tb.probe_dtz(board, dtz)) { LOG_I << "DTZ: " << dtz << END_I; }
+
+  move_list_t moves;
+  board.generate_legal_moves(moves);
+  if (tb.filter_root_moves(board, moves)) {
+    std::string line = "Root moves:";
+    for (const move_t& m : moves) {
+      line += " " + to_string(m);
+    }
+    LOG_I << line << END_I;
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    LOG_E << "Usage: chesso-tb <paths> [--suite | --fen \"<FEN>\"]" << END_E;
+    return EXIT_FAILURE;
+  }
+
+  std::string fen;
+  for (int i = 2; i < argc; ++i) {
+    const std::string arg = argv[i];
+
+    if (arg == "--fen" && i + 1 < argc) {
+      fen = argv[++i];
+    } else if (arg != "--suite") {
+      LOG_E << "Unknown argument " << arg << END_E;
+      return EXIT_FAILURE;
+    }
+  }
+
+  syzygy::tablebases_t tb;
+  const size_t count = tb.init(argv[1]);
+  LOG_I << "Found " << count << " tablebases, up to " << tb.max_pieces()
+        << " pieces" << END_I;
+
+  try {
+    if (!fen.empty()) {
+      print_probe(tb, fen);
+      return EXIT_SUCCESS;
+    }
+
+    bool ok = true;
+    for (const tb_position_t& p : TB_SUITE) {
+      ok = check(tb, p) && ok;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const FAN_exception& e) {
+    LOG_E << e.what() << END_E;
+    return EXIT_FAILURE;
+  }
+}
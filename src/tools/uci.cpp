@@ -0,0 +1,17 @@
+#include <cstdlib>
+#include <iostream>
+#include "uci.hpp"
+
+
+/**
+ * Headless UCI engine: no window, no SDL, only stdin and stdout
+ */
+int main()
+{
+  std::ios::sync_with_stdio(false);
+
+  uci_t uci(std::cin, std::cout);
+  uci.run();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+#include "tt.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+static constexpr int DEPTH_OFFSET = 128;
+
+
+/*******************************************************************************
+ * Entry data layout
+ *
+ *  0 - 15   packed move
+ * 16 - 31   score
+ * 32 - 47   static eval
+ * 48 - 55   depth + DEPTH_OFFSET
+ * 56 - 57   bound
+ * 58 - 63   generation
+ ******************************************************************************/
+static inline uint64_t pack(const uint16_t move,
+                            const int score,
+                            const int eval,
+                            const int depth,
+                            const bound_t bound,
+                            const uint8_t generation)
+{
+  return static_cast<uint64_t>(move) |
+         (static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16) |
+         (static_cast<uint64_t>(static_cast<uint16_t>(eval)) << 32) |
+         (static_cast<uint64_t>(depth + DEPTH_OFFSET) << 48) |
+         (static_cast<uint64_t>(bound) << 56) |
+         (static_cast<uint64_t>(generation) << 58);
+}
+
+static inline uint16_t data_move(const uint64_t d)
+{
+  return static_cast<uint16_t>(d);
+}
+
+static inline int data_depth(const uint64_t d)
+{
+  return static_cast<int>((d >> 48) & 0xFF) - DEPTH_OFFSET;
+}
+
+static inline bound_t data_bound(const uint64_t d)
+{
+  return static_cast<bound_t>((d >> 56) & 0x03);
+}
+
+static inline uint8_t data_generation(const uint64_t d)
+{
+  return static_cast<uint8_t>(d >> 58);
+}
+
+
+transposition_table_t::transposition_table_t(const size_t mb)
+{
+  resize(mb);
+}
+
+
+transposition_table_t::~transposition_table_t()
+{
+  release();
+}
+
+
+void transposition_table_t::release()
+{
+  if (_buckets == nullptr) { return; }
+
+#if defined(__linux__)
+  munmap(_buckets, _allocated_bytes);
+#elif defined(_WIN32)
+  _aligned_free(_buckets);
+#else
+  std::free(_buckets);
+#endif
+
+  _buckets = nullptr;
+  _count = 0;
+  _allocated_bytes = 0;
+  _huge_pages = false;
+}
+
+
+void transposition_table_t::resize(const size_t mb)
+{
+  release();
+
+  // Round up to whole huge pages so the kernel can back all of it
+  const size_t bytes =
+      ((std::max<size_t>(mb, 1) << 20) + HUGE_PAGE_SIZE - 1) &
+      ~(HUGE_PAGE_SIZE - 1);
+  void* memory = nullptr;
+
+#if defined(__linux__)
+  // Explicit huge pages first, they need to be reserved by the admin
+  memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  _huge_pages = memory != MAP_FAILED;
+
+  if (memory == MAP_FAILED) {
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) { throw std::bad_alloc(); }
+
+    // Then ask for transparent huge pages
+#if defined(MADV_HUGEPAGE)
+    _huge_pages = madvise(memory, bytes, MADV_HUGEPAGE) == 0;
+#endif
+  }
+#elif defined(_WIN32)
+  memory = _aligned_malloc(bytes, HUGE_PAGE_SIZE);
+#else
+  memory = std::aligned_alloc(HUGE_PAGE_SIZE, bytes);
+#endif
+
+  if (memory == nullptr) { throw std::bad_alloc(); }
+
+  _buckets = static_cast<bucket_t*>(memory);
+  _count = bytes / sizeof(bucket_t);
+  _allocated_bytes = bytes;
+  std::uninitialized_default_construct_n(_buckets, _count);
+
+  clear();
+}
+
+
+void transposition_table_t::clear()
+{
+  std::memset(static_cast<void*>(_buckets), 0, _count * sizeof(bucket_t));
+  _generation = 0;
+  reset_stats();
+}
+
+
+bool transposition_table_t::probe(const uint64_t key,
+                                  tt_data_t& out,
+                                  const size_t thread)
+{
+  counters_t& counters = _counters[thread % MAX_TT_THREADS];
+  counters.probes.store(counters.probes.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+
+  bucket_t& b = bucket(key);
+
+  for (entry_t* e : {&b.depth_preferred, &b.always_replace}) {
+    const uint64_t data = e->data.load(std::memory_order_relaxed);
+    const uint64_t check = e->key_xor_data.load(std::memory_order_relaxed);
+
+    if ((check ^ data) != key || data_bound(data) == bound_t::NONE) {
+      continue;
+    }
+
+    out.move = data_move(data);
+    out.score = static_cast<int16_t>(data >> 16);
+    out.eval = static_cast<int16_t>(data >> 32);
+    out.depth = data_depth(data);
+    out.bound = data_bound(data);
+
+    counters.hits.store(counters.hits.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+    return true;
+  }
+
+  return false;
+}
+
+
+void transposition_table_t::store(const uint64_t key,
+                                  const int depth,
+                                  const int score,
+                                  const int eval,
+                                  const bound_t bound,
+                                  const uint16_t move)
+{
+  bucket_t& b = bucket(key);
+  entry_t* target = &b.always_replace;
+
+  const uint64_t old = b.depth_preferred.data.load(std::memory_order_relaxed);
+  const bool same_key =
+      (b.depth_preferred.key_xor_data.load(std::memory_order_relaxed) ^ old) ==
+      key;
+
+  if (same_key || data_depth(old) <= depth ||
+      data_generation(old) != _generation ||
+      data_bound(old) == bound_t::NONE) {
+    target = &b.depth_preferred;
+  }
+
+  // Keep the best move we already know if this result doesn't have one
+  uint16_t best = move;
+  if (best == NO_PACKED_MOVE) {
+    const uint64_t current = target->data.load(std::memory_order_relaxed);
+    const uint64_t check = target->key_xor_data.load(std::memory_order_relaxed);
+    if ((check ^ current) == key) { best = data_move(current); }
+  }
+
+  const uint64_t data = pack(best, score, eval, depth, bound, _generation);
+  target->key_xor_data.store(key ^ data, std::memory_order_relaxed);
+  target->data.store(data, std::memory_order_relaxed);
+}
+
+
+int transposition_table_t::hashfull() const
+{
+  const size_t samples = std::min<size_t>(500, _count);
+  int used = 0;
+
+  for (size_t i = 0; i < samples; ++i) {
+    for (const entry_t* e :
+         {&_buckets[i].depth_preferred, &_buckets[i].always_replace}) {
+      const uint64_t data = e->data.load(std::memory_order_relaxed);
+      if (data_bound(data) != bound_t::NONE &&
+          data_generation(data) == _generation) {
+        ++used;
+      }
+    }
+  }
+
+  return samples ? static_cast<int>(used * 1000 / (samples * 2)) : 0;
+}
+
+
+tt_stats_t transposition_table_t::stats() const
+{
+  tt_stats_t res;
+
+  for (const counters_t& c : _counters) {
+    res.probes += c.probes.load(std::memory_order_relaxed);
+    res.hits += c.hits.load(std::memory_order_relaxed);
+  }
+
+  return res;
+}
+
+
+void transposition_table_t::reset_stats()
+{
+  for (counters_t& c : _counters) {
+    c.probes.store(0, std::memory_order_relaxed);
+    c.hits.store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "move.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static constexpr size_t DEFAULT_TT_MB = 64;
+static constexpr size_t MAX_TT_THREADS = 256;
+
+
+/**
+ * High 64 bits of the 128 bits product
+ */
+inline uint64_t mul_hi64(const uint64_t a, const uint64_t b)
+{
+#if defined(_MSC_VER)
+  return __umulh(a, b);
+#elif defined(__SIZEOF_INT128__)
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#else
+  const uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+  const uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+  const uint64_t mid = (a_lo * b_lo >> 32) + (a_hi * b_lo & 0xFFFFFFFF) +
+                       a_lo * b_hi;
+  return a_hi * b_hi + (a_hi * b_lo >> 32) + (mid >> 32);
+#endif
+}
+
+
+enum class bound_t : uint8_t
+{
+  NONE,
+  UPPER,
+  LOWER,
+  EXACT
+};
+
+
+/**
+ * Decoded content of a transposition table entry
+ */
+struct tt_data_t
+{
+  uint16_t move = NO_PACKED_MOVE;
+  int16_t score = 0;
+  int16_t eval = 0;
+  int depth = 0;
+  bound_t bound = bound_t::NONE;
+};
+
+
+struct tt_stats_t
+{
+  uint64_t probes = 0;
+  uint64_t hits = 0;
+
+  inline double hit_rate() const
+  {
+    return probes ? static_cast<double>(hits) / probes : 0.0;
+  }
+};
+
+
+/**
+ * Transposition table shared by all the search threads without locks.
+ *
+ * Every entry is two 64 bit words: the packed data and the key xored with the
+ * data. A reader accepts the entry only if (key ^ data) ^ data gives back its
+ * key, so an entry torn by two threads writing at the same time just looks
+ * like a miss.
+ *
+ * Each bucket holds two entries: the first one is replaced only by deeper (or
+ * newer) results, the second one is always replaced. Two buckets fit in one
+ * cache line.
+ */
+class transposition_table_t
+{
+private:
+  struct entry_t
+  {
+    std::atomic<uint64_t> key_xor_data;
+    std::atomic<uint64_t> data;
+  };
+
+  struct alignas(32) bucket_t
+  {
+    entry_t depth_preferred;
+    entry_t always_replace;
+  };
+
+  // Written by one thread only, read by anyone for the statistics
+  struct alignas(64) counters_t
+  {
+    std::atomic<uint64_t> probes{0};
+    std::atomic<uint64_t> hits{0};
+  };
+
+  bucket_t* _buckets = nullptr;
+  size_t _count = 0;
+  size_t _allocated_bytes = 0;
+  bool _huge_pages = false;
+  uint8_t _generation = 0;
+  std::array<counters_t, MAX_TT_THREADS> _counters;
+
+  void release();
+
+  inline bucket_t& bucket(const uint64_t key) const
+  {
+    // Maps the key on [0, _count) without a modulo
+    const size_t index = static_cast<size_t>(mul_hi64(key, _count));
+    return _buckets[index];
+  }
+
+public:
+  explicit transposition_table_t(const size_t mb = DEFAULT_TT_MB);
+  ~transposition_table_t();
+
+  transposition_table_t(const transposition_table_t&) = delete;
+  transposition_table_t& operator=(const transposition_table_t&) = delete;
+
+  /**
+   * Reallocate the table. Not thread safe: no search can be running.
+   */
+  void resize(const size_t mb);
+
+  void clear();
+
+  /**
+   * Age the entries of the previous searches so they get replaced first
+   */
+  inline void new_search() { _generation = (_generation + 1) & 0x3F; }
+
+  bool probe(const uint64_t key, tt_data_t& out, const size_t thread = 0);
+
+  void store(const uint64_t key,
+             const int depth,
+             const int score,
+             const int eval,
+             const bound_t bound,
+             const uint16_t move);
+
+  /**
+   * Called right after make_move so the bucket is in cache when we probe it
+   */
+  inline void prefetch(const uint64_t key) const
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(&bucket(key));
+#endif
+  }
+
+  /**
+   * Per mille of the entries written by the current search (UCI hashfull)
+   */
+  int hashfull() const;
+
+  tt_stats_t stats() const;
+  void reset_stats();
+
+  inline size_t size_mb() const { return _allocated_bytes >> 20; }
+  inline bool huge_pages() const { return _huge_pages; }
+};
@@ -0,0 +1,394 @@
+#include "uci.hpp"
+#include <algorithm>
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "perft.hpp"
+
+static constexpr size_t MAX_HASH_MB = 65536;
+
+
+uci_t::uci_t(std::istream& in, std::ostream& out)
+    : _in(in), _out(out), _tt(DEFAULT_TT_MB), _search(_tt)
+{
+  // The output is the protocol, the log goes out of the way
+  logging::set_console(&std::cerr);
+
+  _search.on_info = [this](const search_info_t& info) { on_info(info); };
+  _search.on_bestmove = [this](const move_t& best, const move_t& ponder) {
+    if (_search_stats) { send_stats(); }
+    on_bestmove(best, ponder);
+  };
+}
+
+
+void uci_t::send(const std::string& line)
+{
+  std::lock_guard<std::mutex> lock(_out_mutex);
+  _out << line << std::endl;
+}
+
+
+void uci_t::cmd_uci()
+{
+  send("id name Chesso");
+  send("id author macsimbodnar");
+  send("option name Hash type spin default " + std::to_string(DEFAULT_TT_MB) +
+       " min 1 max " + std::to_string(MAX_HASH_MB));
+  send("option name Threads type spin default 1 min 1 max " +
+       std::to_string(MAX_SEARCH_THREADS));
+  send("option name Ponder type check default false");
+  send("option name EvalFile type string default <empty>");
+  send("option name OwnBook type check default false");
+  send("option name BookFile type string default <empty>");
+  send("option name SyzygyPath type string default <empty>");
+  send("option name SyzygyProbeDepth type spin default 1 min 1 max 100");
+  send("option name SyzygyProbeLimit type spin default " +
+       std::to_string(syzygy::MAX_PIECES) + " min 0 max " +
+       std::to_string(syzygy::MAX_PIECES));
+  send("option name LogFile type string default <empty>");
+  if constexpr (SEARCH_STATS) {
+    send("option name SearchStats type check default false");
+    send("option name SearchStatsFile type string default <empty>");
+  }
+  send("uciok");
+}
+
+
+void uci_t::cmd_setoption(std::istringstream& is)
+{
+  std::string token;
+  std::string name;
+  std::string value;
+
+  // setoption name <id> [value <x>]
+  is >> token;
+  while (is >> token && token != "value") {
+    name += (name.empty() ? "" : " ") + token;
+  }
+  while (is >> token) {
+    value += (value.empty() ? "" : " ") + token;
+  }
+
+  _search.stop();
+  _search.wait();
+
+  try {
+    if (name == "Hash") {
+      _tt.resize(std::clamp<size_t>(std::stoul(value), 1, MAX_HASH_MB));
+    } else if (name == "Threads") {
+      _search.set_threads(std::stoul(value));
+    } else if (name == "EvalFile") {
+      load_network(value);
+    } else if (name == "OwnBook") {
+      _own_book = value == "true";
+    } else if (name == "BookFile") {
+      load_book(value);
+    } else if (name == "SyzygyPath") {
+      load_tablebases(value);
+    } else if (name == "SyzygyProbeDepth") {
+      _tb_probe_depth = std::clamp(std::stoi(value), 1, 100);
+      _search.set_tablebases(_tb_probe_limit ? &_tablebases : nullptr,
+                             _tb_probe_depth, _tb_probe_limit);
+    } else if (name == "SyzygyProbeLimit") {
+      _tb_probe_limit = std::clamp(std::stoi(value), 0, syzygy::MAX_PIECES);
+      _search.set_tablebases(_tb_probe_limit ? &_tablebases : nullptr,
+                             _tb_probe_depth, _tb_probe_limit);
+    } else if (name == "LogFile") {
+      const std::string path = value == "<empty>" ? "" : value;
+      if (!logging::set_file(path)) { send("info string can't open " + path); }
+    } else if (name == "SearchStats" && SEARCH_STATS) {
+      _search_stats = value == "true";
+    } else if (name == "SearchStatsFile" && SEARCH_STATS) {
+      open_stats_file(value);
+    } else if (name == "Ponder") {
+      // Nothing to do, the GUI decides when to send go ponder
+    } else {
+      send("info string unknown option " + name);
+    }
+  } catch (const std::exception& e) {
+    send("info string invalid value for " + name + ": " + value);
+  }
+}
+
+
+/**
+ * An empty path or <empty> goes back to the handcrafted evaluation. On error
+ * the current network is kept.
+ */
+void uci_t::load_network(const std::string& path)
+{
+  if (path.empty() || path == "<empty>") {
+    _search.set_network(nullptr);
+    _network.reset();
+    send("info string using the handcrafted evaluation");
+    return;
+  }
+
+  try {
+    std::unique_ptr<nnue::network_t> network = nnue::load(path);
+    _search.set_network(network.get());
+    _network = std::move(network);
+    send("info string NNUE " + path + " loaded, " +
+         nnue::simd_name(nnue::active_simd()) + " kernels");
+  } catch (const input_exception& e) {
+    send("info string " + std::string(e.what()));
+  }
+}
+
+
+/**
+ * Directories separated by ':' (';' on Windows), the tables are mapped only
+ * when the search first needs them. An empty path or <empty> unloads them.
+ */
+void uci_t::load_tablebases(const std::string& paths)
+{
+  const size_t count = _tablebases.init(paths);
+  _search.set_tablebases(_tb_probe_limit ? &_tablebases : nullptr,
+                         _tb_probe_depth, _tb_probe_limit);
+
+  if (count) {
+    send("info string found " + std::to_string(count) +
+         " tablebases, up to " + std::to_string(_tablebases.max_pieces()) +
+         " pieces");
+  } else if (!paths.empty() && paths != "<empty>") {
+    send("info string no tablebase found in " + paths);
+  }
+}
+
+
+/**
+ * An empty path or <empty> closes the book. On error the current book is
+ * closed too.
+ */
+void uci_t::load_book(const std::string& path)
+{
+  if (path.empty() || path == "<empty>") {
+    _book.close();
+    return;
+  }
+
+  try {
+    _book.open(path);
+    send("info string book " + path + " loaded, " +
+         std::to_string(_book.size()) + " entries");
+  } catch (const input_exception& e) {
+    send("info string " + std::string(e.what()));
+  }
+}
+
+
+/**
+ * The statistics are appended to the file, one JSON line per search. An
+ * empty path or <empty> sends them as info string again.
+ */
+void uci_t::open_stats_file(const std::string& path)
+{
+  _stats_file.close();
+  if (path.empty() || path == "<empty>") { return; }
+
+  _stats_file.open(path, std::ios::app);
+  if (!_stats_file.is_open()) { send("info string can't open " + path); }
+}
+
+
+/**
+ * Called by the search thread once the search is over
+ */
+void uci_t::send_stats()
+{
+  const std::string json = _search.stats().to_json();
+
+  if (_stats_file.is_open()) {
+    _stats_file << json << std::endl;
+  } else {
+    send("info string stats " + json);
+  }
+}
+
+
+void uci_t::cmd_position(std::istringstream& is)
+{
+  std::string token;
+  std::string fen;
+
+  // position [startpos | fen <fen>] [moves <m1> ... <mn>]
+  is >> token;
+  if (token == "startpos") {
+    fen = FEN_INIT_POS;
+    is >> token;
+  } else if (token == "fen") {
+    while (is >> token && token != "moves") {
+      fen += (fen.empty() ? "" : " ") + token;
+    }
+  } else {
+    return;
+  }
+
+  _search.stop();
+  _search.wait();
+
+  try {
+    _board.load(fen);
+  } catch (const FAN_exception& e) {
+    send("info string " + std::string(e.what()));
+    _board.load(FEN_INIT_POS);
+    return;
+  }
+
+  move_list_t moves;
+  while (is >> token) {
+    _board.generate_legal_moves(moves);
+
+    bool found = false;
+    for (const move_t& m : moves) {
+      if (to_string(m) == token) {
+        _board.make_move(m);
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      send("info string illegal move " + token);
+      return;
+    }
+
+    // Only the moves the repetition detection may need are kept
+    _board.trim_history();
+  }
+}
+
+
+void uci_t::cmd_go(std::istringstream& is)
+{
+  search_limits_t limits;
+  std::string token;
+
+  const int white = static_cast<int>(color_t::WHITE);
+  const int black = static_cast<int>(color_t::BLACK);
+
+  while (is >> token) {
+    if (token == "wtime") {
+      is >> limits.time[white];
+    } else if (token == "btime") {
+      is >> limits.time[black];
+    } else if (token == "winc") {
+      is >> limits.inc[white];
+    } else if (token == "binc") {
+      is >> limits.inc[black];
+    } else if (token == "movestogo") {
+      is >> limits.movestogo;
+    } else if (token == "depth") {
+      is >> limits.depth;
+      limits.depth = std::clamp(limits.depth, 1, MAX_PLY - 1);
+    } else if (token == "nodes") {
+      is >> limits.nodes;
+    } else if (token == "movetime") {
+      is >> limits.movetime;
+    } else if (token == "infinite") {
+      limits.infinite = true;
+    } else if (token == "ponder") {
+      limits.ponder = true;
+    } else if (token == "perft") {
+      int depth = 1;
+      is >> depth;
+
+      _search.stop();
+      _search.wait();
+
+      // Through send() like everything else on the protocol stream
+      const uint64_t nodes = perft_divide(
+          _board, std::max(depth, 1), [this](const move_t& m, uint64_t n) {
+            send(to_string(m) + ": " + std::to_string(n));
+          });
+      send("Nodes searched: " + std::to_string(nodes));
+      return;
+    }
+  }
+
+  // A book move is played at once, unless the GUI wants to see a search
+  move_t book_move;
+  if (_own_book && !limits.infinite && !limits.ponder &&
+      _book.probe(_board, book_move)) {
+    _search.stop();
+    _search.wait();
+
+    send("info string book move " + to_string(book_move));
+    on_bestmove(book_move, NULL_MOVE);
+    return;
+  }
+
+  _search.start(_board, limits);
+}
+
+
+void uci_t::on_info(const search_info_t& info)
+{
+  std::ostringstream ss;
+  ss << "info depth " << info.depth << " seldepth " << info.seldepth
+     << " score ";
+
+  if (info.is_mate()) {
+    ss << "mate " << info.mate_in();
+  } else {
+    ss << "cp " << info.score;
+  }
+
+  ss << " nodes " << info.nodes << " nps " << info.nps << " hashfull "
+     << info.hashfull << " tbhits " << info.tb_hits << " time "
+     << info.time_ms << " pv";
+
+  for (int i = 0; i < info.pv.length; ++i) {
+    ss << " " << to_string(info.pv.moves[i]);
+  }
+
+  send(ss.str());
+}
+
+
+void uci_t::on_bestmove(const move_t& best, const move_t& ponder)
+{
+  std::string line = "bestmove " + to_string(best);
+  if (ponder != NULL_MOVE) { line += " ponder " + to_string(ponder); }
+
+  send(line);
+}
+
+
+void uci_t::run()
+{
+  std::string line;
+  std::string token;
+
+  while (std::getline(_in, line)) {
+    std::istringstream is(line);
+    token.clear();
+    is >> token;
+
+    if (token == "quit") {
+      break;
+    } else if (token == "uci") {
+      cmd_uci();
+    } else if (token == "isready") {
+      send("readyok");
+    } else if (token == "ucinewgame") {
+      _search.clear();
+      _tt.clear();
+    } else if (token == "setoption") {
+      cmd_setoption(is);
+    } else if (token == "position") {
+      cmd_position(is);
+    } else if (token == "go") {
+      cmd_go(is);
+    } else if (token == "stop") {
+      _search.stop();
+    } else if (token == "ponderhit") {
+      _search.ponderhit();
+    } else if (!token.empty()) {
+      send("info string unknown command " + token);
+    }
+  }
+
+  _search.stop();
+  _search.wait();
+}
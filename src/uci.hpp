@@ -0,0 +1,65 @@
+#pragma once
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include "board.hpp"
+#include "nnue.hpp"
+#include "polyglot.hpp"
+#include "search.hpp"
+#include "syzygy.hpp"
+#include "tt.hpp"
+
+
+/**
+ * Universal Chess Interface front end
+ *
+ * The input thread only parses commands, the search runs in the background
+ * so stop, ponderhit and isready are answered while it is thinking. Every
+ * write to the output goes through one mutex because the search thread
+ * prints info and bestmove on its own.
+ */
+class uci_t
+{
+private:
+  std::istream& _in;
+  std::ostream& _out;
+  std::mutex _out_mutex;
+
+  transposition_table_t _tt;
+  std::unique_ptr<nnue::network_t> _network;
+  syzygy::tablebases_t _tablebases;
+  polyglot::book_t _book;
+  bool _own_book = false;
+  bool _search_stats = false;
+  std::ofstream _stats_file;
+  int _tb_probe_depth = 1;
+  int _tb_probe_limit = syzygy::MAX_PIECES;
+  search_t _search;
+  board_t _board;
+
+  void send(const std::string& line);
+
+  void cmd_uci();
+  void cmd_setoption(std::istringstream& is);
+  void load_network(const std::string& path);
+  void load_tablebases(const std::string& paths);
+  void load_book(const std::string& path);
+  void open_stats_file(const std::string& path);
+  void send_stats();
+  void cmd_position(std::istringstream& is);
+  void cmd_go(std::istringstream& is);
+
+  void on_info(const search_info_t& info);
+  void on_bestmove(const move_t& best, const move_t& ponder);
+
+public:
+  uci_t(std::istream& in = std::cin, std::ostream& out = std::cout);
+
+  /**
+   * Read commands until quit or the end of the input
+   */
+  void run();
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * Zobrist keys
+ *
+ * The tables are generated at compile time with splitmix64 from a fixed seed
+ * so every build (and every run) produces the same hash for a position.
+ * Pieces are indexed by piece code and 0x88 square, castling by the 4 bits
+ * rights mask and en passant by the file of the target square.
+ */
+namespace zobrist {
+
+struct keys_t
+{
+  std::array<std::array<uint64_t, 128>, 16> piece_square = {};
+  std::array<uint64_t, 16> castling = {};
+  std::array<uint64_t, 8> en_passant = {};
+  uint64_t side = 0;
+};
+
+
+constexpr uint64_t splitmix64(uint64_t& state)
+{
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+constexpr keys_t generate_keys()
+{
+  keys_t k;
+  uint64_t state = 0xC4E550C4E550ULL;
+
+  for (auto& piece : k.piece_square) {
+    for (auto& square : piece) {
+      square = splitmix64(state);
+    }
+  }
+
+  // No castling rights hash to 0 so the key of a bare position is unchanged
+  for (size_t i = 1; i < k.castling.size(); ++i) {
+    k.castling[i] = splitmix64(state);
+  }
+
+  for (auto& file : k.en_passant) {
+    file = splitmix64(state);
+  }
+
+  k.side = splitmix64(state);
+
+  return k;
+}
+
+
+inline constexpr keys_t KEYS = generate_keys();
+
+}  // namespace zobrist